@@ -4,6 +4,9 @@
 #include <chrono>
 #include <thread>
 #include <atomic>
+#include <stdexcept>
+#include <cstring>
+#include <type_traits>
 
 
 /*
@@ -53,14 +56,68 @@
 	#include <shared_anchor.hpp>
 #endif
 
+/*
+	Real-time profile.  Locking and releasing shared pointers and retiring a life_lock
+		never allocate, take a mutex or make a system call; in particular the deleter
+		does not notify.  destroy() polls for expiration instead of blocking.
+		(A std::stop_source attached to the lock is an exception: retirement requests a stop.)
+*/
+#ifndef LIFE_LOCK_REALTIME
+	#define LIFE_LOCK_REALTIME 0
+#endif
+
 // Whether to use C++20 wait/notify behavior rather than our own spinlock.
 #ifndef LIFE_LOCK_CPP20
-	#if __cpp_lib_atomic_wait || __cplusplus >= 202002L || _MSVC_LANG >= 202002L
+	#if LIFE_LOCK_REALTIME
+		#define LIFE_LOCK_CPP20 0
+	#elif __cpp_lib_atomic_wait || __cplusplus >= 202002L || _MSVC_LANG >= 202002L
 		#define LIFE_LOCK_CPP20 1
 	#else
 		#define LIFE_LOCK_CPP20 0
 	#endif
 #endif
+#if LIFE_LOCK_REALTIME && LIFE_LOCK_CPP20
+	#error "LIFE_LOCK_REALTIME is incompatible with C++20 wait/notify (LIFE_LOCK_CPP20)."
+#endif
+// Whether retirement can also signal a C++20 std::stop_source.
+#ifndef LIFE_LOCK_STOP_TOKEN
+	#if __cplusplus >= 202002L || _MSVC_LANG >= 202002L
+		#define LIFE_LOCK_STOP_TOKEN 1
+	#else
+		#define LIFE_LOCK_STOP_TOKEN 0
+	#endif
+#endif
+#if LIFE_LOCK_STOP_TOKEN
+	#include <stop_token>
+#endif
+// Whether to provide life_locked aliases using std::pmr (C++17).
+#ifndef LIFE_LOCK_PMR
+	#if (__cplusplus >= 201703L || _MSVC_LANG >= 201703L) && defined(__has_include)
+		#if __has_include(<memory_resource>)
+			#define LIFE_LOCK_PMR 1
+		#endif
+	#endif
+	#ifndef LIFE_LOCK_PMR
+		#define LIFE_LOCK_PMR 0
+	#endif
+#endif
+#if LIFE_LOCK_PMR
+	#include <memory_resource>
+#endif
+// Whether to provide C++20 coroutine awaitables for expiration.
+#ifndef LIFE_LOCK_COROUTINE
+	#if defined(__cpp_impl_coroutine) && defined(__has_include)
+		#if __has_include(<coroutine>)
+			#define LIFE_LOCK_COROUTINE 1
+		#endif
+	#endif
+	#ifndef LIFE_LOCK_COROUTINE
+		#define LIFE_LOCK_COROUTINE 0
+	#endif
+#endif
+#if LIFE_LOCK_COROUTINE
+	#include <coroutine>
+#endif
 #ifndef LIFE_LOCK_FALLTHROUGH
 	#if __cplusplus >= 201700L || _MSVC_LANG >= 201700L
 		#define LIFE_LOCK_FALLTHROUGH [[fallthrough]]
@@ -80,9 +137,130 @@
 	#define LIFE_LOCK_SLEEP_MAX_USEC 100000
 #endif
 
+// Cache line size assumed by life_locked_isolated and cache_aligned_allocator.
+#ifndef LIFE_LOCK_CACHE_LINE
+	#define LIFE_LOCK_CACHE_LINE 64
+#endif
+
 
 namespace edb
 {
+	template<class T> class gated_weak_ptr;
+	class life_stop_token;
+#if LIFE_LOCK_COROUTINE
+	template<class Executor> class expiration_awaiter;
+
+	// The default executor for coroutines awaiting expiration, which resumes them immediately.
+	struct resume_inline    {void operator()(std::coroutine_handle<> h) const    {h.resume();}};
+#endif
+	struct life_locked_packed;
+	template<typename T, class Alloc = std::allocator<char>, class Layout = life_locked_packed> class life_locked;
+
+	namespace detail
+	{
+		/*
+			Poll an atomic word until ready(value) holds, without any notification.
+				Spins a few times before performing exponential backoff.
+			Returns the number of unsuccessful checks (zero if no wait was needed).
+		*/
+		template<class Word, class Ready>
+		size_t poll_word(const std::atomic<Word> &word, Ready ready)
+		{
+			size_t n = 0;
+
+			// 1: Spin for a short time.
+			while (!ready(word.load(std::memory_order_acquire)))
+				if (++n >= LIFE_LOCK_SPIN_COUNT) break;
+			if (n < LIFE_LOCK_SPIN_COUNT) return n;
+
+			// 2: Wait increasing periods of time.
+			size_t wait_usec = 1;
+			while (!ready(word.load(std::memory_order_acquire)))
+			{
+				++n;
+				std::this_thread::sleep_for(std::chrono::microseconds(wait_usec));
+				wait_usec *= 2;
+				if (wait_usec > LIFE_LOCK_SLEEP_MAX_USEC) wait_usec = LIFE_LOCK_SLEEP_MAX_USEC;
+			}
+			return n;
+		}
+
+		/*
+			Wait until ready(value) holds for an atomic word.
+				With C++20, blocks on the word, which must be notified when it changes.
+				Otherwise polls the word as above.
+		*/
+		template<class Word, class Ready>
+		size_t await_word(const std::atomic<Word> &word, Ready ready)
+		{
+#if LIFE_LOCK_CPP20
+			// Use standard C++ library's notify mechanism.
+			size_t n = 0;
+			Word value = word.load(std::memory_order_acquire);
+			while (!ready(value))
+			{
+				++n;
+				word.wait(value, std::memory_order_acquire);
+				value = word.load(std::memory_order_acquire);
+			}
+			return n;
+#else
+			return poll_word(word, ready);
+#endif
+		}
+
+		/*
+			Poll an atomic word until ready(value) holds, calling idle() between checks.
+				idle() returns whether it did any work; if not, back off as in poll_word.
+		*/
+		template<class Word, class Ready, class Idle>
+		size_t await_word(const std::atomic<Word> &word, Ready ready, Idle &&idle)
+		{
+			size_t n = 0, spins = 0, wait_usec = 1;
+			while (!ready(word.load(std::memory_order_acquire)))
+			{
+				++n;
+				if (idle()) {spins = 0; wait_usec = 1; continue;}
+				if (++spins < LIFE_LOCK_SPIN_COUNT) continue;
+				std::this_thread::sleep_for(std::chrono::microseconds(wait_usec));
+				wait_usec *= 2;
+				if (wait_usec > LIFE_LOCK_SLEEP_MAX_USEC) wait_usec = LIFE_LOCK_SLEEP_MAX_USEC;
+			}
+			return n;
+		}
+
+		/*
+			Poll an atomic word as in poll_word, giving up at a deadline.
+				Returns whether ready(value) holds.
+		*/
+		template<class Word, class Ready, class Clock, class Duration>
+		bool poll_word_until(const std::atomic<Word> &word, Ready ready, const std::chrono::time_point<Clock, Duration> &deadline)
+		{
+			for (size_t n = 0; n < LIFE_LOCK_SPIN_COUNT; ++n)
+				if (ready(word.load(std::memory_order_acquire))) return true;
+
+			auto wait = std::chrono::microseconds(1);
+			while (!ready(word.load(std::memory_order_acquire)))
+			{
+				auto now = Clock::now();
+				if (now >= deadline) return false;
+				std::this_thread::sleep_for(std::min<typename Clock::duration>(wait, deadline - now));
+				wait *= 2;
+				if (wait.count() > LIFE_LOCK_SLEEP_MAX_USEC) wait = std::chrono::microseconds(LIFE_LOCK_SLEEP_MAX_USEC);
+			}
+			return true;
+		}
+	}
+
+	/*
+		Called by a life_lock's deleter when the lock expires, from the thread which
+			released the last shared pointer.  See life_lock::retire_notify.
+	*/
+	struct expiration_listener
+	{
+		void (*on_expired)(expiration_listener *self);
+	};
+
 	/*
 		life_lock provides "special" weak and shared pointers to an object, which
 			may exist anywhere including on the stack or as a member variable.
@@ -106,7 +284,8 @@ namespace edb
 	public:
 		enum status_t : uintptr_t
 		{
-			working = 3, // don't modify these values.
+			armed   = 4, // don't modify these values.
+			working = 3,
 			retired = 2,
 			expired = 1,
 			empty   = 0
@@ -124,9 +303,30 @@ namespace edb
 		template<class T, class Alloc> life_lock(T *ptr, Alloc alloc)    : life_lock(_internal_tag{}, std::shared_ptr<_status_word>(&_status, _deleter{}, std::forward<Alloc>(alloc))) {}
 
 
-		// Manually initialize a previously uninitialized life_lock.
-		void                       init()                                {if (status() == empty) _ref = std::shared_ptr<_status_word>(&_status, _deleter{});}
-		template<class Alloc> void init(Alloc alloc)                     {if (status() == empty) _ref = std::shared_ptr<_status_word>(&_status, _deleter{}, std::forward<Alloc>(alloc));}
+		// Manually initialize a previously uninitialized (or armed) life_lock.
+		void                       init()                                {_init(_deleter{});}
+		template<class Alloc> void init(Alloc alloc)                     {_init(_deleter{}, std::forward<Alloc>(alloc));}
+
+		/*
+			Arm an uninitialized life_lock for lazy initialization.
+				The shared reference is created when smart pointers are first requested,
+				so a lock which is never shared costs no allocation or atomic operation.
+		*/
+		void arm() noexcept                                              {if (status() == empty) _arm();}
+
+#if LIFE_LOCK_STOP_TOKEN
+		// Initialize with a std::stop_source, which is asked to stop when the life_lock is retired.
+		template<class T> life_lock(T *ptr, std::stop_source stop)       : life_lock(_internal_tag{}, std::shared_ptr<_status_word>(&_status, _deleter{std::move(stop)})) {}
+		void              init(std::stop_source stop)                    {_init(_deleter{std::move(stop)});}
+
+		/*
+			Get a std::stop_token from a shared_ptr made by a life_lock which was
+				initialized with a std::stop_source.  Otherwise, the token can't stop.
+				(This relies on std::get_deleter, and therefore on RTTI.)
+		*/
+		template<class T>
+		static std::stop_token get_stop_token(const std::shared_ptr<T> &ptr) noexcept    {auto d = std::get_deleter<_deleter>(ptr); return d ? d->stop.get_token() : std::stop_token();}
+#endif
 
 
 		/*
@@ -140,18 +340,89 @@ namespace edb
 			shared_ptr derived from these methods will block the object's destruction.
 
 			life_lock's primary use is creating weak_ptr; use lock() only with care.
+			An armed life_lock initializes itself here.
 		*/
-		template<class T> std::weak_ptr  <T> weak(T *ptr) const noexcept    {return _weak  (ptr);}
-		template<class T> std::shared_ptr<T> lock(T *ptr) const noexcept    {return _shared(ptr);}
+		template<class T> std::weak_ptr  <T> weak(T *ptr) const    {_init_armed(); return _weak  (ptr);}
+		template<class T> std::shared_ptr<T> lock(T *ptr) const    {_init_armed(); return _shared(ptr);}
+
+		/*
+			Write n weak pointers to the object into an output iterator.
+				Creating a weak_ptr may cost a round trip on the strong count;
+				here that cost is paid once, and each copy touches only the weak count.
+		*/
+		template<class T, class OutIt>
+		OutIt weak_n(T *ptr, size_t n, OutIt out) const
+		{
+			if (n) {std::weak_ptr<T> w = weak(ptr); while (--n) *out++ = w; *out++ = std::move(w);}
+			return out;
+		}
+
+		/*
+			Get a weak pointer which cannot be locked after the life_lock is retired,
+				even while older shared pointers survive.  See gated_weak_ptr.
+		*/
+		template<class T> gated_weak_ptr<T> gated_weak(T *ptr) const    {return gated_weak_ptr<T>(weak(ptr), &_status);}
+
+		/*
+			Get a token which reports when this life_lock has been retired.
+				Long-running holders may poll it and release their references early.
+		*/
+		life_stop_token stop_token() const noexcept;
+
+		/*
+			Retire the life_lock, arranging for listener.on_expired to be called when it expires.
+				This happens in whichever thread releases the last shared pointer,
+				which may be this one, before retire_notify returns.
+				(This relies on std::get_deleter, and therefore on RTTI.)
+
+			Returns false without registering if the lock was not working;
+				it is then expired or empty, unless it was retired earlier.
+		*/
+		bool retire_notify(expiration_listener &listener) noexcept
+		{
+			if (status() != working) {retire(); return false;}
+			std::shared_ptr<void> ref = retire();
+			auto d = std::get_deleter<_deleter>(ref);
+			if (d) d->listener = &listener;
+			return d != nullptr;
+		}
+
+		/*
+			Wait until the life_lock expires, without retiring it.  Any number of threads may wait.
+				Returns immediately if the life_lock is expired or empty.
+				The life_lock must outlive the waiting threads; threads which don't
+				control its lifetime should wait on an expiration_latch instead.
+		*/
+		void wait_expired() const                                        {detail::await_word(_status, &_is_expired);}
+
+		// As above, giving up after a timeout.  Returns whether the life_lock expired.
+		template<class Rep, class Period>
+		bool wait_expired_for(const std::chrono::duration<Rep, Period> &timeout) const
+		{
+			return detail::poll_word_until(_status, &_is_expired, std::chrono::steady_clock::now() + timeout);
+		}
+
+#if LIFE_LOCK_COROUTINE
+		/*
+			co_await retire_and_wait() to retire the life_lock and suspend until it expires,
+				then finalize it as destroy() would, without blocking a thread.
+				The deleter resumes the coroutine with exec(handle); by default it
+				resumes immediately, in the thread which released the last shared pointer.
+		*/
+		template<class Executor = resume_inline>
+		expiration_awaiter<Executor> retire_and_wait(Executor exec = {})    {return expiration_awaiter<Executor>(*this, std::move(exec));}
+#endif
 
 		/*
 			Query the status of the life_lock.
+				armed -- the life_lock will initialize itself on first use.
 				empty -- the life_lock is in an uninitialized state.
 		*/
 		status_t status() const noexcept
 		{
 			switch (_status.load(std::memory_order_acquire))
 			{
+			case armed:   case _arming: return armed;
 			case retired: return retired;
 			case expired: return expired;
 			default: return _ref.use_count() ? working : empty;
@@ -173,21 +444,39 @@ namespace edb
 				Afterward, state() will be empty.
 
 			Return value indicates whether waiting was necessary.
-		*/
 
-		size_t destroy()
+			An idle function may be supplied, which is called between checks for
+				expiration while waiting.  It should perform a small amount of work,
+				such as one task from a queue, and return whether it did anything.
+				The lock is polled rather than awaited when an idle function is used.
+		*/
+		template<class... Idle>
+		size_t destroy(Idle&&... idle)
 		{
 			size_t n=0;
 			switch (status())
 			{
+			case armed:   _finalize(); return n;
 			default:
-			case working: retire();                     LIFE_LOCK_FALLTHROUGH;
-			case retired: n=_await_expiration(_status); LIFE_LOCK_FALLTHROUGH;
-			case expired: _finalize();                  LIFE_LOCK_FALLTHROUGH;
+			case working: retire();                                                  LIFE_LOCK_FALLTHROUGH;
+			case retired: n=_await_expiration(_status, std::forward<Idle>(idle)...); LIFE_LOCK_FALLTHROUGH;
+			case expired: _finalize();                                               LIFE_LOCK_FALLTHROUGH;
 			case empty:   return n;
 			}
 		}
 
+		/*
+			Destroy the reference as above, then initialize the life_lock again.
+				An armed life_lock is armed again.  Pointers made before renewal
+				belong to the previous generation and remain expired.
+				An allocator may be supplied to recycle the shared reference's storage;
+				as arming can't hold an allocator, this initializes an armed life_lock.
+
+			Return value is that of destroy().
+		*/
+		size_t                       renew()               {bool lazy = (status() == armed); size_t n = destroy(); if (lazy) arm(); else init(); return n;}
+		template<class Alloc> size_t renew(Alloc alloc)    {size_t n = destroy(); init(std::forward<Alloc>(alloc)); return n;}
+
 
 	protected:
 		// life_lock cannot be copied (which could cause deadlock)
@@ -202,50 +491,101 @@ namespace edb
 
 		struct _deleter
 		{
+#if LIFE_LOCK_STOP_TOKEN
+			std::stop_source stop {std::nostopstate};
+#endif
+			mutable expiration_listener *listener = nullptr;
+
 			void operator()(_status_word *lock) const noexcept
 			{
+				expiration_listener *l = listener;
 				lock->store(expired, std::memory_order_release);
 #if LIFE_LOCK_CPP20
-				lock->notify_one();
+				lock->notify_all(); // the destroyer and any wait_expired callers
 #endif
+				if (l) l->on_expired(l);
 			}
 		};
 
 		struct _internal_tag {};
 
+		static bool _is_expired(uintptr_t s) noexcept    {return s == expired || s == empty;}
+
+		// Transitional state while an armed life_lock initializes.
+		enum : uintptr_t {_arming = 5};
+
+		template<class... Args> void _init(Args&&... args)
+		{
+			switch (status())
+			{
+			case empty: _ref = std::shared_ptr<_status_word>(&_status, std::forward<Args>(args)...); break;
+			case armed:
+			{
+				// Several threads may race to initialize an armed lock; one wins.
+				uintptr_t s = armed;
+				if (_status.compare_exchange_strong(s, _arming, std::memory_order_acquire))
+					_publish(std::shared_ptr<_status_word>(&_status, std::forward<Args>(args)...));
+				else while (s == _arming)
+					{std::this_thread::yield(); s = _status.load(std::memory_order_acquire);}
+				break;
+			}
+			default: break;
+			}
+		}
+		template<class... Alloc> void _init_armed(Alloc&&... alloc) const
+		{
+			switch (_status.load(std::memory_order_acquire))
+			{
+			case armed: case _arming: const_cast<life_lock*>(this)->_init(_deleter{}, std::forward<Alloc>(alloc)...); break;
+			}
+		}
+
+		template<typename T, class Alloc, class Layout> friend class life_locked;
+
+		template<class P> static void _request_stop(const P &ref) noexcept
+		{
+#if LIFE_LOCK_STOP_TOKEN
+			if (auto d = std::get_deleter<_deleter>(ref)) d->stop.request_stop();
+#endif
+		}
+
 #if !LIFE_LOCK_COMPRESS
 		/*
 			Standard (safe) implementation.
 				Typically 3 words (12 or 24 bytes) in size.
 		*/
-		std::shared_ptr<_status_word> _ref;
-		_status_word                  _status = empty;
+		mutable std::shared_ptr<_status_word> _ref;
+		mutable _status_word                  _status {empty};
 
 		life_lock(_internal_tag, std::shared_ptr<_status_word> ptr = {})
 			:
 			_ref(std::move(ptr)), _status(_ref ? working : empty) {}
 
+		// weak_ptr has no aliasing constructor, so this round-trips the strong count.
 		template<class T> std::weak_ptr  <T> _weak  (T *p) const noexcept    {return _shared(p);}
 		template<class T> std::shared_ptr<T> _shared(T *p) const noexcept    {return std::shared_ptr<T>(_ref, p);}
 
 		std::shared_ptr<_status_word> _retire() noexcept
 		{
+			if (_status.load(std::memory_order_relaxed) == armed) {_status.store(expired, std::memory_order_release); return {};}
 			decltype(_ref) ref = std::move(_ref);
-			if (ref) _status.store(retired, std::memory_order_release);
+			if (ref) {_status.store(retired, std::memory_order_release); _request_stop(ref);}
 			return ref;
 		}
 		void _finalize() noexcept    {_status.store(empty, std::memory_order_release);}
 		void _destruct() noexcept    {}
+		void _arm()      noexcept    {_status.store(armed, std::memory_order_relaxed);}
+		void _publish(std::shared_ptr<_status_word> &&ref) noexcept    {_ref = std::move(ref); _status.store(working, std::memory_order_release);}
 #else
 		/*
 			Low-memory implementation.
 				Relies on assumption that shared_anchor's first word
-				(typically null or a pointer) never has value 0 or 1.
+				(typically null or a pointer) never has value 1, 2, 4 or 5.
 		*/
 		union
 		{
-			shared_anchor _ref;
-			_status_word  _status;
+			mutable shared_anchor _ref;
+			mutable _status_word  _status;
 		};
 
 		life_lock(_internal_tag, std::shared_ptr<_status_word> ptr = {})
@@ -258,51 +598,47 @@ namespace edb
 		std::shared_ptr<void> _retire()
 		{
 			std::shared_ptr<void> ref;
-			if (status() == working)
+			switch (status())
 			{
+			case armed:
+				_status.store(expired, std::memory_order_release);
+				break;
+			case working:
 				ref = _ref.release<void>(nullptr);
 				_ref.~shared_anchor();
 				_status.store(retired, std::memory_order_relaxed);
+				_request_stop(ref);
+				break;
+			default: break;
 			}
 			return ref;
 		}
 		void _finalize() noexcept    {new (&_ref) shared_anchor();}
+		void _arm()      noexcept    {_ref.~shared_anchor(); _status.store(armed, std::memory_order_relaxed);}
+		void _publish(std::shared_ptr<_status_word> &&ref) noexcept
+		{
+			// The status word overlaps the anchor's first word, so that word is published last.
+			alignas(shared_anchor) unsigned char buf[sizeof(shared_anchor)];
+			new (buf) shared_anchor(std::move(ref));
+			std::memcpy(reinterpret_cast<unsigned char*>(&_ref) + sizeof(_status_word), buf + sizeof(_status_word), sizeof(shared_anchor) - sizeof(_status_word));
+			uintptr_t first;
+			std::memcpy(&first, buf, sizeof(first));
+			_status.store(first, std::memory_order_release);
+		}
 		void _destruct() noexcept    {switch (_status.load()) {case retired: case expired: break; default: _ref.~shared_anchor();} }
 #endif
 
-		static size_t _await_expiration(_status_word &lock)
+		template<class... Idle>
+		static size_t _await_expiration(_status_word &lock, Idle&&... idle)
 		{
-			size_t n = 0;
-
-			// 1: only wait if the lock's state is initially "retired".
+			// Only wait if the lock's state is initially "retired".
 			switch (lock.load(std::memory_order_acquire))
 			{
 			default: throw std::runtime_error("Invalid state for awaiting expiration");
-			case empty: case expired: return n;
+			case empty: case expired: return 0;
 			case retired: break;
 			}
-			++n;
-
-#if LIFE_LOCK_CPP20
-			// Use standard C++ library's notify mechanism.
-			lock.wait(retired, std::memory_order_acquire);
-#else
-
-			// 2: Spin for a short time.
-			while (n++ < LIFE_LOCK_SPIN_COUNT)
-				if (lock.load(std::memory_order_acquire) == expired) return n;
-
-			// 3: Wait increasing periods of time.
-			size_t wait_usec = 1;
-			while (lock.load(std::memory_order_acquire) != expired)
-			{
-				++n;
-				std::this_thread::sleep_for(std::chrono::microseconds(wait_usec));
-				wait_usec *= 2;
-				if (wait_usec > LIFE_LOCK_SLEEP_MAX_USEC) wait_usec = LIFE_LOCK_SLEEP_MAX_USEC;
-			}
-#endif
-			return n;
+			return detail::await_word(lock, [](uintptr_t s) {return s != retired;}, std::forward<Idle>(idle)...);
 		}
 	};
 
@@ -323,49 +659,435 @@ namespace edb
 	};
 
 
-	// Placeholder for life_locked constructor
+	/*
+		A weak pointer which refuses to lock once its life_lock has been retired.
+
+		Ordinary weak_ptr can still be locked after retire() as long as any other
+			shared_ptr survives, so overlapping holders may delay destroy() forever.
+			gated_weak_ptr checks the lock's status after locking and gives up if
+			the lock is retired.  destroy() then waits only for references which
+			existed at retirement, bounding its latency by the longest single hold.
+
+		The gate only applies to references obtained through gated_weak_ptr.
+	*/
+	template<class T>
+	class gated_weak_ptr
+	{
+	public:
+		constexpr gated_weak_ptr() noexcept                              : _status(nullptr) {}
+		template<class Y> gated_weak_ptr(const gated_weak_ptr<Y> &o)     : _ptr(o._ptr), _status(o._status) {}
+
+		// Lock the pointer, failing if the object is gone or its life_lock is retired.
+		std::shared_ptr<T> lock() const noexcept
+		{
+			std::shared_ptr<T> p = _ptr.lock();
+			if (p && _status->load(std::memory_order_acquire) == life_lock::retired) p.reset();
+			return p;
+		}
+
+		// These functions are equivalent to the ones in std::weak_ptr.
+		bool expired()   const noexcept    {return _ptr.expired();}
+		long use_count() const noexcept    {return _ptr.use_count();}
+		void reset()           noexcept    {_ptr.reset(); _status = nullptr;}
+
+		// Access the underlying (ungated) weak pointer.
+		const std::weak_ptr<T> &weak() const noexcept    {return _ptr;}
+
+		// Get a token reporting retirement; poll it only while holding a reference from lock().
+		life_stop_token stop_token() const noexcept;
+
+
+	private:
+		friend class life_lock;
+		template<class Y> friend class gated_weak_ptr;
+
+		gated_weak_ptr(std::weak_ptr<T> &&ptr, const std::atomic<uintptr_t> *status) noexcept    : _ptr(std::move(ptr)), _status(status) {}
+
+		std::weak_ptr<T>               _ptr;
+		const std::atomic<uintptr_t> *_status;
+	};
+
+
+	/*
+		A cheap signal that a life_lock has been retired, similar to std::stop_token.
+			A worker holding a shared_ptr through a long loop can poll stop_requested()
+			(a single relaxed load) and release its reference early, shortening destroy().
+
+		The token reads the life_lock's own state, so it must only be polled while
+			the life_lock exists -- in practice, while holding a shared_ptr made from it.
+	*/
+	class life_stop_token
+	{
+	public:
+		constexpr life_stop_token() noexcept    : _status(nullptr) {}
+
+		bool stop_possible()  const noexcept    {return _status != nullptr;}
+		bool stop_requested() const noexcept
+		{
+			if (!_status) return false;
+			switch (_status->load(std::memory_order_relaxed))
+			{
+			case life_lock::retired: case life_lock::expired: return true;
+			default: return false;
+			}
+		}
+
+
+	private:
+		friend class life_lock;
+		template<class T> friend class gated_weak_ptr;
+
+		constexpr life_stop_token(const std::atomic<uintptr_t> *status) noexcept    : _status(status) {}
+
+		const std::atomic<uintptr_t> *_status;
+	};
+
+	inline                   life_stop_token life_lock        ::stop_token() const noexcept    {return life_stop_token(&_status);}
+	template<class T> inline life_stop_token gated_weak_ptr<T>::stop_token() const noexcept    {return life_stop_token(_status);}
+
+
+#if LIFE_LOCK_COROUTINE
+	/*
+		An awaitable for the expiration of a life_lock, returned by retire_and_wait.
+			Suspends unless the lock has already expired, and finalizes the lock on resumption.
+	*/
+	template<class Executor>
+	class expiration_awaiter : private expiration_listener
+	{
+	public:
+		bool await_ready() const noexcept    {return false;}
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			_handle = handle;
+			if (!_lock->retire_notify(*this))
+			{
+				if (_lock->status() == life_lock::retired) throw std::runtime_error("life_lock was retired before retire_and_wait");
+				return false;
+			}
+			// The deleter may already have run; whichever of us comes second resumes.
+			return !_fired.exchange(true, std::memory_order_acq_rel);
+		}
+		void await_resume()                  {_lock->destroy(); if (_finish) _finish(_object);}
+
+	private:
+		friend class life_lock;
+		template<typename T, class Alloc, class Layout> friend class life_locked;
+
+		expiration_awaiter(life_lock &lock, Executor exec, void (*finish)(void*) = nullptr, void *object = nullptr)
+			:
+			expiration_listener{&_on_expired}, _lock(&lock), _exec(std::move(exec)), _finish(finish), _object(object), _fired(false) {}
+
+		static void _on_expired(expiration_listener *self)
+		{
+			auto *awaiter = static_cast<expiration_awaiter*>(self);
+			if (awaiter->_fired.exchange(true, std::memory_order_acq_rel)) awaiter->_exec(awaiter->_handle);
+		}
+
+		life_lock               *_lock;
+		Executor                 _exec;
+		void                   (*_finish)(void*);
+		void                    *_object;
+		std::atomic<bool>        _fired;
+		std::coroutine_handle<>  _handle;
+	};
+
+
+	/*
+		life_pin keeps an object alive within a coroutine, but not across its suspensions.
+			It locks a gated_weak_ptr on construction.  Awaiting pin.unpinned(awaiter)
+			releases the shared pointer while suspended and locks it again on resumption,
+			so the object's lifetime never waits on the coroutine's I/O.
+
+		After each resumption, check the pin; it is empty if the object was retired.
+	*/
+	template<class T>
+	class life_pin
+	{
+	public:
+		life_pin() noexcept                                              {}
+		explicit life_pin(gated_weak_ptr<T> weak) noexcept               : _weak(std::move(weak)), _ref(_weak.lock()) {}
+
+		T *get()        const noexcept                                   {return _ref.get();}
+		T *operator->() const noexcept                                   {return _ref.get();}
+		T &operator*()  const noexcept                                   {return *_ref;}
+		explicit operator bool() const noexcept                          {return bool(_ref);}
+
+		// Release the object, and stop tracking it.
+		void reset() noexcept                                            {_ref.reset(); _weak.reset();}
+
+		/*
+			Wrap an awaiter so that the object is unpinned while the coroutine is suspended.
+				The awaiter's result is passed through.  If the object was pinned before,
+				it is locked again on resumption, which fails if it was retired meanwhile.
+		*/
+		template<class Awaiter>
+		auto unpinned(Awaiter &&awaiter)                                 {return _unpinned<Awaiter>(*this, std::forward<Awaiter>(awaiter));}
+
+	private:
+		template<class Awaiter>
+		class _unpinned
+		{
+		public:
+			_unpinned(life_pin &pin, Awaiter &&awaiter)                  : _pin(&pin), _awaiter(std::forward<Awaiter>(awaiter)), _was_pinned(bool(pin)) {}
+
+			bool await_ready()                                           {return _awaiter.await_ready();}
+			template<class Promise>
+			decltype(auto) await_suspend(std::coroutine_handle<Promise> handle)
+			{
+				// The coroutine may be resumed in another thread before this returns.
+				_pin->_ref.reset();
+				return _awaiter.await_suspend(handle);
+			}
+			decltype(auto) await_resume()
+			{
+				if (_was_pinned && !_pin->_ref) _pin->_ref = _pin->_weak.lock();
+				return _awaiter.await_resume();
+			}
+
+		private:
+			life_pin *_pin;
+			Awaiter   _awaiter;
+			bool      _was_pinned;
+		};
+
+		gated_weak_ptr<T>  _weak;
+		std::shared_ptr<T> _ref;
+	};
+#endif
+
+
+	/*
+		expiration_latch lets any number of threads wait for a life_lock to expire,
+			including threads which don't control the lock's lifetime.
+			retire(lock) retires the lock and attaches the latch to its deleter,
+			which opens the latch when the last shared pointer is released.
+
+		The latch must outlive the expiration; its destructor waits for it.
+	*/
+	class expiration_latch : private expiration_listener
+	{
+	public:
+		expiration_latch() noexcept                                      : expiration_listener{&_on_expired}, _state(_idle) {}
+		~expiration_latch()                                              {if (_state.load(std::memory_order_relaxed) != _idle) detail::poll_word(_state, [](uint32_t s) {return s == _open;});}
+
+		expiration_latch(const expiration_latch&) = delete;
+		expiration_latch &operator=(const expiration_latch&) = delete;
+
+		/*
+			Retire a life_lock or life_locked object and attach the latch to it.
+				The latch opens immediately if the lock is expired or empty.
+				Throws if the lock was already retired, or the latch already attached.
+		*/
+		template<class Lockable>
+		void retire(Lockable &lock)
+		{
+			uint32_t s = _idle;
+			if (!_state.compare_exchange_strong(s, _waiting, std::memory_order_relaxed)) throw std::logic_error("expiration_latch is already attached");
+			if (lock.retire_notify(*this)) return;
+			if (lock.status() == life_lock::retired)
+			{
+				_state.store(_idle, std::memory_order_relaxed);
+				throw std::runtime_error("life_lock was retired before attaching expiration_latch");
+			}
+			_on_expired(this);
+		}
+
+		// Whether the latch has opened.
+		bool expired() const noexcept                                    {return _state.load(std::memory_order_acquire) >= _opening;}
+
+		// Wait for the latch to open, optionally with a timeout.
+		void wait() const                                                {detail::await_word(_state, [](uint32_t s) {return s >= _opening;});}
+		template<class Rep, class Period>
+		bool wait_for(const std::chrono::duration<Rep, Period> &timeout) const
+		{
+			return detail::poll_word_until(_state, [](uint32_t s) {return s >= _opening;}, std::chrono::steady_clock::now() + timeout);
+		}
+
+	private:
+		enum : uint32_t {_idle, _waiting, _opening, _open};
+
+		static void _on_expired(expiration_listener *self) noexcept
+		{
+			// Waiters may return as soon as the latch is opening; the destructor waits until it is open.
+			auto *latch = static_cast<expiration_latch*>(self);
+			latch->_state.store(_opening, std::memory_order_release);
+#if LIFE_LOCK_CPP20
+			latch->_state.notify_all();
+#endif
+			latch->_state.store(_open, std::memory_order_release);
+		}
+
+		std::atomic<uint32_t> _state;
+	};
+
+
+	// Placeholders for life_locked constructor
 	enum life_locked_empty_t    {life_locked_empty};
+	enum life_locked_lazy_t     {life_locked_lazy};
+
+	/*
+		Layout policies for life_locked.
+			packed   -- the lock directly follows the object, using the least memory.
+			isolated -- the object and the lock each begin on a new cache line, so that
+			            traffic on the lock does not contend with the object's hot fields.
+	*/
+	struct life_locked_packed
+	{
+		template<class T> struct align {static const size_t object = alignof(T), lock = alignof(life_lock);};
+	};
+	struct life_locked_isolated
+	{
+		template<class T> struct align {static const size_t object = (alignof(T) > LIFE_LOCK_CACHE_LINE ? alignof(T) : LIFE_LOCK_CACHE_LINE), lock = LIFE_LOCK_CACHE_LINE;};
+	};
+
+	/*
+		An allocator giving each allocation whole cache lines of its own.
+			Suitable for a life_lock's shared reference, whose reference counts
+			are modified by every thread that locks it.
+	*/
+	template<class T>
+	class cache_aligned_allocator
+	{
+	public:
+		using value_type = T;
+
+		cache_aligned_allocator() noexcept                                          {}
+		template<class U> cache_aligned_allocator(const cache_aligned_allocator<U>&) noexcept    {}
+
+		T *allocate(size_t n)
+		{
+			static_assert(alignof(T) <= LIFE_LOCK_CACHE_LINE, "cache_aligned_allocator cannot over-align this type");
+			const size_t line = LIFE_LOCK_CACHE_LINE, size = (n*sizeof(T) + line-1) / line * line;
+			void *raw = ::operator new(size + line);
+			uintptr_t p = (reinterpret_cast<uintptr_t>(raw) + line) & ~uintptr_t(line-1);
+			reinterpret_cast<void**>(p)[-1] = raw; // stored in the padding before the block
+			return reinterpret_cast<T*>(p);
+		}
+		void deallocate(T *p, size_t) noexcept    {::operator delete(reinterpret_cast<void**>(p)[-1]);}
+
+		template<class U> bool operator==(const cache_aligned_allocator<U>&) const noexcept    {return true;}
+		template<class U> bool operator!=(const cache_aligned_allocator<U>&) const noexcept    {return false;}
+	};
+
+	namespace detail
+	{
+		// Holds an allocator, taking no space when it is empty.
+		template<class Alloc>
+		class alloc_holder : private Alloc
+		{
+		public:
+			alloc_holder(const Alloc &alloc = Alloc()) noexcept    : Alloc(alloc) {}
+			const Alloc &get() const noexcept                      {return *this;}
+		};
+
+		// Whether life_locked's constructor arguments begin with a tag.
+		template<typename... Args> struct life_locked_tagged : std::false_type {};
+		template<typename A, typename... Args> struct life_locked_tagged<A, Args...> : std::integral_constant<bool,
+			std::is_same<typename std::decay<A>::type, std::allocator_arg_t>::value ||
+			std::is_same<typename std::decay<A>::type, life_locked_lazy_t>::value> {};
+	}
 
 	/*
 		This class contains an object protected by a life_lock.
 			weak and shared pointers to the object may be created.
 			The object's destruction will be blocked until no shared pointers to it exist.
 			Additionally, life_locked supports an "empty" state like std::optional.
+
+		The lock's shared reference is allocated with Alloc, which may be supplied
+			using std::allocator_arg.  Note that the allocation is released only
+			when the last weak pointer to the object is gone.
+
+		Layout may be life_locked_isolated to keep the lock and object on separate
+			cache lines; combine with cache_aligned_allocator to also isolate the
+			shared reference's counts.
 	*/
-	template<typename T>
-	class life_locked
+	template<typename T, class Alloc, class Layout>
+	class life_locked : private detail::alloc_holder<Alloc>
 	{
 	public:
+		using allocator_type = Alloc;
+
 		// Construct with T's constructor arguments, or T() for the default constructor.
-		template<typename... Args>
-		life_locked(Args&&... args)    : _lock(new (_t()) T (std::forward<Args>(args)...)) {}
+		template<typename... Args, typename = typename std::enable_if<!detail::life_locked_tagged<Args...>::value>::type>
+		life_locked(Args&&... args)    : _lock(new (_t()) T (std::forward<Args>(args)...), _alloc()) {}
 		
 		// Construct life_locked in an empty/destroyed state.
 		life_locked(life_locked_empty_t)    {}
 
+		// Construct with T's constructor arguments, deferring the lock's initialization until first use.
+		template<typename... Args>
+		life_locked(life_locked_lazy_t, Args&&... args)    {new (_t()) T (std::forward<Args>(args)...); _lock.arm();}
+
+		// As above, using the given allocator for the lock's shared reference.
+		template<typename... Args>
+		life_locked(std::allocator_arg_t, const Alloc &alloc, Args&&... args)                        : _holder(alloc), _lock(new (_t()) T (std::forward<Args>(args)...), alloc) {}
+		life_locked(std::allocator_arg_t, const Alloc &alloc, life_locked_empty_t)                   : _holder(alloc) {}
+		template<typename... Args>
+		life_locked(std::allocator_arg_t, const Alloc &alloc, life_locked_lazy_t, Args&&... args)    : _holder(alloc) {new (_t()) T (std::forward<Args>(args)...); _lock.arm();}
+
+		allocator_type get_allocator() const noexcept    {return _alloc();}
+
 		// Wait until all shared_ptr have expired and destroy the contained object.
 		~life_locked()    {destroy();}
-		void retire()     {if (_lock) {_lock.retire();}}
-		void destroy()    {if (_lock) {_lock.destroy(); _t()->~T();}}
-		void reset()      {if (_lock) {_lock.destroy(); _t()->~T();}}  // "reset" alias for consistency with std::optional
+		void destroy()    {if (_has()) {_lock.destroy(); _t()->~T();}}
+		template<class Idle> void destroy(Idle &&idle)    {if (_has()) {_lock.destroy(std::forward<Idle>(idle)); _t()->~T();}}  // see life_lock::destroy
+
+#if LIFE_LOCK_COROUTINE
+		// co_await to destroy the object without blocking a thread.  See life_lock::retire_and_wait.
+		template<class Executor = resume_inline>
+		expiration_awaiter<Executor> retire_and_wait(Executor exec = {})    {return expiration_awaiter<Executor>(_lock, std::move(exec), _has() ? &_destroy_t : nullptr, _obj);}
+#endif
+		void reset()      {if (_has()) {_lock.destroy(); _t()->~T();}}  // "reset" alias for consistency with std::optional
+
+		// Retire the lock.  Returns its shared reference, which is safe to discard.
+		std::shared_ptr<void> retire() noexcept    {return _has() ? _lock.retire() : nullptr;}
+		bool retire_notify(expiration_listener &listener) noexcept    {return _has() && _lock.retire_notify(listener);}  // see life_lock::retire_notify
+
+		/*
+			Destroy any contained object, then construct a new one in the same storage.
+				Weak pointers to the previous object remain expired.
+				A lazy life_locked stays lazy.
+		*/
+		template<typename... Args>
+		T &emplace(Args&&... args)
+		{
+			bool lazy = (_lock.status() == life_lock::armed);
+			destroy();
+			new (_t()) T (std::forward<Args>(args)...);
+			if (lazy) _lock.arm();
+			else try {_lock.init(_alloc());} catch (...) {_lock.destroy(); _t()->~T(); throw;}  // a failed init leaves the lock expired
+			return *_t();
+		}
 
 		// Get weak pointer
-		std::weak_ptr        <T>   weak()       noexcept    {return _lock.weak(raw_ptr());}
-		std::weak_ptr  <const T>   weak() const noexcept    {return _lock.weak(raw_ptr());}
-		std::shared_ptr<      T>   lock()       noexcept    {return _lock.lock(raw_ptr());}
-		std::shared_ptr<const T>   lock() const noexcept    {return _lock.lock(raw_ptr());}
-		operator std::weak_ptr      <T>()       noexcept    {return _lock.weak(raw_ptr());}
-		operator std::weak_ptr<const T>() const noexcept    {return _lock.weak(raw_ptr());}
-
-		// Check on contained value
-		bool has_value()         const noexcept    {return _lock;}
-		explicit operator bool() const noexcept    {return _lock;}
+		std::weak_ptr        <T>   weak()                {return _armed().weak(raw_ptr());}
+		std::weak_ptr  <const T>   weak() const          {return _armed().weak(raw_ptr());}
+		std::shared_ptr<      T>   lock()                {return _armed().lock(raw_ptr());}
+		std::shared_ptr<const T>   lock() const          {return _armed().lock(raw_ptr());}
+		operator std::weak_ptr      <T>()                {return _armed().weak(raw_ptr());}
+		operator std::weak_ptr<const T>() const          {return _armed().weak(raw_ptr());}
+
+		// Write n weak pointers into an output iterator (cheaper than n calls to weak).
+		template<class OutIt> OutIt weak_n(size_t n, OutIt out)          {return _armed().weak_n(raw_ptr(), n, out);}
+		template<class OutIt> OutIt weak_n(size_t n, OutIt out) const    {return _armed().weak_n(raw_ptr(), n, out);}
+
+		// Get a weak pointer which cannot be locked after retire().
+		gated_weak_ptr      <T>   gated_weak()          {return _armed().gated_weak(raw_ptr());}
+		gated_weak_ptr<const T>   gated_weak() const    {return _armed().gated_weak(raw_ptr());}
+
+		// Get a token reporting retirement, for holders who may release early.
+		life_stop_token           stop_token() const noexcept    {return _lock.stop_token();}
+
+		// Check on contained value (which remains after retire, until destroyed)
+		bool has_value()         const noexcept    {return _has();}
+		life_lock::status_t status() const noexcept    {return _lock.status();}
+		explicit operator bool() const noexcept    {return _has();}
 		T       &value()       noexcept            {return *raw_ptr();}
 		const T &value() const noexcept            {return *raw_ptr();}
 
 		// Access the contained object.
-		T       *raw_ptr   ()       noexcept    {return _lock ? _t() : nullptr;}
-		const T *raw_ptr   () const noexcept    {return _lock ? _t() : nullptr;}
+		T       *raw_ptr   ()       noexcept    {return _has() ? _t() : nullptr;}
+		const T *raw_ptr   () const noexcept    {return _has() ? _t() : nullptr;}
 		T       *operator->()       noexcept    {return  raw_ptr();}
 		const T *operator->() const noexcept    {return  raw_ptr();}
 		T&       operator* ()       noexcept    {return *raw_ptr();}
@@ -374,7 +1096,6 @@ namespace edb
 
 		/*
 			TODO: conform more closely to std::optional...
-				- emplace
 				- value_or
 				- swap
 				- std::hash ??
@@ -383,9 +1104,25 @@ namespace edb
 
 
 	private:
-		alignas(T) char _obj[sizeof(T)];
-		life_lock       _lock;
+		using _align = typename Layout::template align<T>;
+
+		alignas(_align::object) char      _obj[sizeof(T)];
+		alignas(_align::lock)   life_lock _lock;
 		const T        *_t() const noexcept     {return reinterpret_cast<const T*>(_obj);}
 		T              *_t()       noexcept     {return reinterpret_cast<      T*>(_obj);}
+		bool            _has() const noexcept   {return _lock.status() != life_lock::empty;}
+		static void     _destroy_t(void *t)     {static_cast<T*>(t)->~T();}
+
+		using _holder = detail::alloc_holder<Alloc>;
+		const Alloc      &_alloc() const noexcept    {return _holder::get();}
+		const life_lock  &_armed() const             {_lock._init_armed(_alloc()); return _lock;}
 	};
+
+#if LIFE_LOCK_PMR
+	namespace pmr
+	{
+		// life_locked allocating its lock's shared reference from a std::pmr::memory_resource.
+		template<typename T> using life_locked = edb::life_locked<T, std::pmr::polymorphic_allocator<char>>;
+	}
+#endif
 }
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <life_lock.hpp>
+
+
+/*
+	life_lock_asymmetric moves the cost of memory fences from readers to the owner.
+
+	Readers announce the object they are using in a per-thread slot, using plain
+		stores and a compiler barrier, then check that the lock is still working.
+		No atomic read-modify-write or fence is performed on the reading path.
+
+	When retiring, the owner issues a process-wide barrier with Linux's
+		membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED), which orders every running
+		thread's announcements against the retirement.  The owner then waits
+		until no reader slot names the lock.
+
+	Where membarrier is unavailable, readers fall back on a sequentially
+		consistent fence, and the protocol remains correct.
+*/
+
+
+// Whether Linux membarrier can be used for the owner's barrier.
+#ifndef LIFE_LOCK_MEMBARRIER
+	#if defined(__linux__) && defined(__has_include)
+		#if __has_include(<linux/membarrier.h>)
+			#define LIFE_LOCK_MEMBARRIER 1
+		#endif
+	#endif
+	#ifndef LIFE_LOCK_MEMBARRIER
+		#define LIFE_LOCK_MEMBARRIER 0
+	#endif
+#endif
+#if LIFE_LOCK_MEMBARRIER
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <linux/membarrier.h>
+#endif
+
+// How many asymmetric locks one thread may hold at the same time.
+#ifndef LIFE_LOCK_ASYMMETRIC_SLOTS
+	#define LIFE_LOCK_ASYMMETRIC_SLOTS 4
+#endif
+
+
+namespace edb
+{
+	template<class T> class asymmetric_weak_ptr;
+	template<class T> class asymmetric_ptr;
+
+	namespace detail
+	{
+		/*
+			Reader slots for one thread, which are recycled when the thread exits.
+				Only the owning thread stores into its slots.
+		*/
+		struct asymmetric_reader
+		{
+			alignas(LIFE_LOCK_CACHE_LINE) std::atomic<const void*> slots[LIFE_LOCK_ASYMMETRIC_SLOTS];
+			std::atomic<bool>  in_use;
+			asymmetric_reader *next;      // immutable once the record is published
+			bool               expedited; // whether membarrier orders this thread's stores
+
+			// Announce a lock to the owner.  The caller must then check its status.
+			std::atomic<const void*> *announce(const void *anchor)
+			{
+				for (auto &slot : slots) if (!slot.load(std::memory_order_relaxed))
+				{
+					slot.store(anchor, std::memory_order_relaxed);
+					if (expedited) std::atomic_signal_fence(std::memory_order_seq_cst);
+					else           std::atomic_thread_fence(std::memory_order_seq_cst);
+					return &slot;
+				}
+				throw std::runtime_error("Too many asymmetric locks held by one thread");
+			}
+		};
+
+		// Registry of all reader records in the process.  Never destroyed.
+		class asymmetric_domain
+		{
+		public:
+			static asymmetric_domain &get()    {static asymmetric_domain *domain = new asymmetric_domain(); return *domain;}
+
+			// The calling thread's reader record.
+			static asymmetric_reader &reader()
+			{
+				struct handle
+				{
+					asymmetric_reader *rec;
+					handle()     : rec(get()._claim()) {}
+					~handle()    {rec->in_use.store(false, std::memory_order_release);}
+				};
+				static thread_local handle h;
+				return *h.rec;
+			}
+
+			// Order all threads' prior announcements before our subsequent loads.
+			void heavy_fence() const noexcept
+			{
+#if LIFE_LOCK_MEMBARRIER
+				if (_expedited) {syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0); return;}
+#endif
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+
+			// Wait until no reader slot names the given lock.  Returns the number of slots waited on.
+			size_t await_readers(const void *anchor) const
+			{
+				size_t n = 0;
+				for (asymmetric_reader *r = _head.load(std::memory_order_acquire); r; r = r->next)
+					for (auto &slot : r->slots)
+						n += (poll_word(slot, [anchor](const void *p) {return p != anchor;}) != 0);
+				return n;
+			}
+
+		private:
+			asymmetric_domain() : _head(nullptr), _expedited(false)
+			{
+#if LIFE_LOCK_MEMBARRIER
+				_expedited = (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0);
+#endif
+			}
+
+			asymmetric_reader *_claim()
+			{
+				for (asymmetric_reader *r = _head.load(std::memory_order_acquire); r; r = r->next)
+				{
+					bool free = false;
+					if (r->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) return r;
+				}
+				asymmetric_reader *r = new (cache_aligned_allocator<asymmetric_reader>().allocate(1)) asymmetric_reader();
+				for (auto &slot : r->slots) slot.store(nullptr, std::memory_order_relaxed);
+				r->in_use.store(true, std::memory_order_relaxed);
+				r->expedited = _expedited;
+				r->next = _head.load(std::memory_order_relaxed);
+				while (!_head.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed)) {}
+				return r;
+			}
+
+			std::atomic<asymmetric_reader*> _head;
+			bool                            _expedited;
+		};
+
+		// Shared between a lock and its weak pointers, which keep the status word valid.
+		struct asymmetric_anchor
+		{
+			std::atomic<uintptr_t> status;
+			asymmetric_anchor() noexcept    : status(life_lock::working) {}
+		};
+	}
+
+
+	/*
+		A lock whose readers perform no atomic read-modify-write operations.
+			weak() creates asymmetric_weak_ptr; locking one yields asymmetric_ptr,
+			which is tied to the locking thread and should be short-lived.
+
+		Copying an asymmetric_weak_ptr does modify a reference count,
+			so readers should keep their weak pointers rather than copy them.
+	*/
+	class life_lock_asymmetric
+	{
+	public:
+		// Construct an uninitialized lock, or an initialized one.
+		life_lock_asymmetric() noexcept                                  {}
+		template<class T> life_lock_asymmetric(T *ptr)                   {init();}
+		~life_lock_asymmetric()                                          {destroy();}
+
+		life_lock_asymmetric(const life_lock_asymmetric&) = delete;
+		life_lock_asymmetric &operator=(const life_lock_asymmetric&) = delete;
+
+		// Initialize a previously uninitialized lock.
+		void init()
+		{
+			detail::asymmetric_domain::get(); // register with membarrier before any reader
+			destroy();
+			_anchor = std::make_shared<detail::asymmetric_anchor>();
+		}
+
+		// Get a weak pointer, which readers lock without fences.
+		template<class T>
+		asymmetric_weak_ptr<T> weak(T *ptr) const                        {return asymmetric_weak_ptr<T>(_anchor, ptr);}
+
+		life_lock::status_t status() const noexcept
+		{
+			if (!_anchor) return life_lock::empty;
+			return life_lock::status_t(_anchor->status.load(std::memory_order_acquire));
+		}
+		explicit operator bool() const noexcept                          {return status() == life_lock::working;}
+
+		// Prevent any further locking.  Existing readers are unaffected.
+		void retire() noexcept                                           {if (_anchor) _anchor->status.store(life_lock::retired, std::memory_order_relaxed);}
+
+		/*
+			Retire the lock, issue the heavy barrier and wait for readers to finish.
+				Return value indicates whether waiting was necessary.
+		*/
+		size_t destroy()
+		{
+			if (!_anchor) return 0;
+			retire();
+			auto &domain = detail::asymmetric_domain::get();
+			domain.heavy_fence();
+			size_t n = domain.await_readers(_anchor.get());
+			_anchor->status.store(life_lock::expired, std::memory_order_relaxed);
+			_anchor.reset();
+			return n;
+		}
+
+	private:
+		std::shared_ptr<detail::asymmetric_anchor> _anchor;
+	};
+
+
+	/*
+		A reference obtained from asymmetric_weak_ptr::lock().
+			Must be released by the thread that locked it.
+	*/
+	template<class T>
+	class asymmetric_ptr
+	{
+	public:
+		asymmetric_ptr() noexcept                                        : _ptr(nullptr), _slot(nullptr) {}
+		~asymmetric_ptr() noexcept                                       {reset();}
+
+		asymmetric_ptr(asymmetric_ptr &&o) noexcept                      : _ptr(o._ptr), _slot(o._slot) {o._ptr = nullptr; o._slot = nullptr;}
+		asymmetric_ptr &operator=(asymmetric_ptr &&o) noexcept           {reset(); std::swap(_ptr, o._ptr); std::swap(_slot, o._slot); return *this;}
+
+		void reset() noexcept                                            {if (_slot) _slot->store(nullptr, std::memory_order_release); _ptr = nullptr; _slot = nullptr;}
+
+		T *get()        const noexcept                                   {return _ptr;}
+		T *operator->() const noexcept                                   {return _ptr;}
+		T &operator*()  const noexcept                                   {return *_ptr;}
+		explicit operator bool() const noexcept                          {return _ptr != nullptr;}
+
+	private:
+		friend class asymmetric_weak_ptr<T>;
+		asymmetric_ptr(T *ptr, std::atomic<const void*> *slot) noexcept    : _ptr(ptr), _slot(slot) {}
+
+		T                        *_ptr;
+		std::atomic<const void*> *_slot;
+	};
+
+
+	/*
+		A weak pointer from a life_lock_asymmetric.
+			Locking it announces the lock in a per-thread slot and checks the lock's status.
+	*/
+	template<class T>
+	class asymmetric_weak_ptr
+	{
+	public:
+		asymmetric_weak_ptr() noexcept                                   : _ptr(nullptr) {}
+
+		asymmetric_ptr<T> lock() const
+		{
+			if (!_anchor || _anchor->status.load(std::memory_order_relaxed) != life_lock::working) return {};
+			auto *slot = detail::asymmetric_domain::reader().announce(_anchor.get());
+			if (_anchor->status.load(std::memory_order_acquire) != life_lock::working)
+			{
+				slot->store(nullptr, std::memory_order_relaxed);
+				return {};
+			}
+			return asymmetric_ptr<T>(_ptr, slot);
+		}
+
+		bool expired() const noexcept                                    {return !_anchor || _anchor->status.load(std::memory_order_relaxed) != life_lock::working;}
+		void reset()         noexcept                                    {_anchor.reset(); _ptr = nullptr;}
+
+	private:
+		friend class life_lock_asymmetric;
+		asymmetric_weak_ptr(std::shared_ptr<detail::asymmetric_anchor> anchor, T *ptr) noexcept    : _anchor(std::move(anchor)), _ptr(ptr) {}
+
+		std::shared_ptr<detail::asymmetric_anchor> _anchor;
+		T                                         *_ptr;
+	};
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cassert>
+#include <life_lock.hpp>
+
+
+/*
+	life_lock_biased is a life_lock biased toward the thread which owns it.
+
+	The owner thread (which initializes, retires and destroys the lock) locks the
+		object with owner_lock(), adjusting a plain counter.  Other threads use
+		weak and shared pointers as usual, which adjust the shared atomic count.
+
+	When the lock is retired while owner references remain, the owner's references
+		are merged into the shared count as a single shared reference, released
+		along with the last owner reference.  Thus the lock expires only after
+		both kinds of reference are gone.
+*/
+
+
+namespace edb
+{
+	class life_lock_biased
+	{
+	public:
+		template<class T> class owner_ptr;
+
+	public:
+		// Construct an uninitialized lock, or an initialized one.
+		life_lock_biased() noexcept                                      : _owners(0), _working(false) {}
+		template<class T> life_lock_biased(T *ptr)                       : _lock(ptr), _owners(0), _working(true) {}
+		~life_lock_biased()                                              {assert(!_owners && "life_lock_biased destroyed while holding owner references"); retire(); _lock.destroy();}
+
+		life_lock_biased(const life_lock_biased&) = delete;
+		life_lock_biased &operator=(const life_lock_biased&) = delete;
+
+		// Initialize a previously uninitialized lock.  (owner thread only)
+		void init()                                                      {_lock.init(); _working = true;}
+
+		/*
+			Lock the object from the owner thread, without atomic operations.
+				Fails after the lock is retired, like life_lock::lock.
+				owner_ptr must not be shared with, or released by, other threads.
+		*/
+		template<class T> owner_ptr<T> owner_lock(T *ptr) noexcept       {return _working ? owner_ptr<T>(ptr, this) : owner_ptr<T>();}
+
+		// Get smart pointers to the object for other threads, as with life_lock.
+		template<class T> std::weak_ptr  <T>  weak(T *ptr) const          {return _lock.weak(ptr);}
+		template<class T> std::shared_ptr<T>  lock(T *ptr) const          {return _lock.lock(ptr);}
+		template<class T> gated_weak_ptr <T>  gated_weak(T *ptr) const    {return _lock.gated_weak(ptr);}
+		life_stop_token                       stop_token() const noexcept {return _lock.stop_token();}
+
+		// Query the status of the lock, which counts owner references once retired.
+		life_lock::status_t status() const noexcept                      {return _lock.status();}
+		explicit operator bool() const noexcept                          {return status() == life_lock::working;}
+		size_t owner_count() const noexcept                              {return _owners;}
+
+		/*
+			Retire the lock.  (owner thread only)
+				Outstanding owner references are merged into the shared count.
+		*/
+		void retire() noexcept
+		{
+			if (!_working) return;
+			_working = false;
+			if (_owners) _merged = _lock.retire();
+			else         _lock.retire();
+		}
+
+		/*
+			Retire the lock and wait for other threads' references to expire.
+				The owner must release its own references first, as waiting on them
+				would never finish.  Return value indicates whether waiting was necessary.
+
+			destroy() throws if owner references remain.  The destructor can't, so
+				there it is a precondition, which is asserted; otherwise it deadlocks,
+				like destroying a life_lock while holding a reference.
+		*/
+		size_t destroy()
+		{
+			retire();
+			if (_owners) throw std::runtime_error("life_lock_biased destroyed by the owner while holding owner references");
+			return _lock.destroy();
+		}
+
+	private:
+		void _release() noexcept    {if (!--_owners) _merged.reset();}
+
+		life_lock             _lock;
+		size_t                _owners;   // modified only by the owner thread
+		bool                  _working;  // ditto
+		std::shared_ptr<void> _merged;   // holds the shared count for owner references after retirement
+	};
+
+
+	/*
+		A reference to an object held by the owner thread of a life_lock_biased.
+			Copying and destroying it costs a plain increment or decrement.
+	*/
+	template<class T>
+	class life_lock_biased::owner_ptr
+	{
+	public:
+		owner_ptr() noexcept                                             : _ptr(nullptr), _lock(nullptr) {}
+		~owner_ptr() noexcept                                            {reset();}
+
+		owner_ptr(const owner_ptr &o) noexcept                           : _ptr(o._ptr), _lock(o._lock) {if (_lock) ++_lock->_owners;}
+		owner_ptr(owner_ptr &&o) noexcept                                : _ptr(o._ptr), _lock(o._lock) {o._ptr = nullptr; o._lock = nullptr;}
+		owner_ptr &operator=(owner_ptr o) noexcept                       {std::swap(_ptr, o._ptr); std::swap(_lock, o._lock); return *this;}
+
+		void reset() noexcept                                            {if (_lock) _lock->_release(); _ptr = nullptr; _lock = nullptr;}
+
+		T *get()        const noexcept                                   {return _ptr;}
+		T *operator->() const noexcept                                   {return _ptr;}
+		T &operator*()  const noexcept                                   {return *_ptr;}
+		explicit operator bool() const noexcept                          {return _lock != nullptr;}
+
+	private:
+		friend class life_lock_biased;
+		owner_ptr(T *ptr, life_lock_biased *lock) noexcept               : _ptr(ptr), _lock(lock) {++_lock->_owners;}
+
+		T                *_ptr;
+		life_lock_biased *_lock;
+	};
+}
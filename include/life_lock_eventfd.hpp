@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <system_error>
+#include <life_lock.hpp>
+
+#ifndef __linux__
+	#error "life_lock_eventfd.hpp requires Linux"
+#endif
+#include <cerrno>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+
+/*
+	life_lock_eventfd lets an event loop tear down life-locked objects without
+		blocking or dedicating a thread to waiting.
+
+	retire() retires a lock and registers an expiration_listener with its deleter.
+		When the last shared pointer is released, in whatever thread, the listener
+		writes to an eventfd shared by every lock retired through the same object.
+		The event loop polls fd() alongside its other descriptors, and when it is
+		readable calls collect(), which finalizes the locks that have expired.
+
+	All functions except the listener are called from the event loop's thread.
+*/
+
+
+namespace edb
+{
+	class life_lock_eventfd
+	{
+	public:
+		life_lock_eventfd()
+			:
+			_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), _signalling(0)
+		{
+			if (_fd < 0) throw std::system_error(errno, std::system_category(), "eventfd");
+		}
+
+		// Wait for every pending lock to expire and finalize it.
+		~life_lock_eventfd()
+		{
+			for (auto &e : _pending)
+			{
+				detail::poll_word(e->fired, [](bool fired) {return fired;});
+				e->finalize_now();
+			}
+			// Listeners may still be writing to the eventfd.
+			detail::poll_word(_signalling, [](size_t n) {return n == 0;});
+			close(_fd);
+		}
+
+		life_lock_eventfd(const life_lock_eventfd&) = delete;
+		life_lock_eventfd &operator=(const life_lock_eventfd&) = delete;
+
+		// The descriptor to poll for readability.
+		int fd() const noexcept    {return _fd;}
+
+		/*
+			Retire a life_lock and call finalize(context) from collect() once it expires.
+				Typically finalize destroys the object containing the lock.
+				Throws if the lock was already retired, as its expiration can't be observed.
+		*/
+		void retire(life_lock &lock, void (*finalize)(void*), void *context)
+		{
+			_add(&lock, [](void *l, expiration_listener &e) {return static_cast<life_lock*>(l)->retire_notify(e);},
+				[](void *l) {return static_cast<life_lock*>(l)->status();},
+				[](void *l) {static_cast<life_lock*>(l)->destroy();}, finalize, context);
+		}
+
+		// Retire a life_locked object allocated with new, and delete it from collect().
+		template<typename T, class Alloc, class Layout>
+		void retire(life_locked<T, Alloc, Layout> *object)
+		{
+			using obj_t = life_locked<T, Alloc, Layout>;
+			_add(object, [](void *o, expiration_listener &e) {return static_cast<obj_t*>(o)->retire_notify(e);},
+				[](void *o) {return static_cast<obj_t*>(o)->status();},
+				[](void *) {}, [](void *o) {delete static_cast<obj_t*>(o);}, object);
+		}
+
+		/*
+			Finalize every lock which has expired, after clearing the eventfd.
+				Returns the number of locks finalized.
+		*/
+		size_t collect()
+		{
+			uint64_t count;
+			while (read(_fd, &count, sizeof(count)) < 0 && errno == EINTR) {}
+
+			size_t n = 0;
+			for (size_t i = 0; i < _pending.size();)
+			{
+				if (!_pending[i]->fired.load(std::memory_order_acquire)) {++i; continue;}
+				std::unique_ptr<_entry> e = std::move(_pending[i]);
+				_pending[i] = std::move(_pending.back());
+				_pending.pop_back();
+				e->finalize_now();
+				++n;
+			}
+			return n;
+		}
+
+		// The number of retired locks not yet finalized.
+		size_t pending() const noexcept    {return _pending.size();}
+
+	private:
+		struct _entry : expiration_listener
+		{
+			life_lock_eventfd  *owner;
+			std::atomic<bool>   fired;
+			void               *subject;
+			void              (*destroy)(void*);
+			void              (*finalize)(void*);
+			void               *context;
+
+			_entry(life_lock_eventfd *owner, void *subject, void (*destroy)(void*), void (*finalize)(void*), void *context) noexcept
+				:
+				expiration_listener{&_on_expired}, owner(owner), fired(false), subject(subject), destroy(destroy), finalize(finalize), context(context) {}
+
+			static void _on_expired(expiration_listener *self) noexcept
+			{
+				// The entry may be finalized as soon as fired is set, but the owner can't close its eventfd until we're done.
+				auto *e = static_cast<_entry*>(self);
+				life_lock_eventfd *owner = e->owner;
+				owner->_signalling.fetch_add(1, std::memory_order_acquire);
+				e->fired.store(true, std::memory_order_release);
+				uint64_t one = 1;
+				while (write(owner->_fd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+				owner->_signalling.fetch_sub(1, std::memory_order_release);
+			}
+
+			void finalize_now()    {destroy(subject); finalize(context);}
+		};
+
+		void _add(void *subject, bool (*notify)(void*, expiration_listener&), life_lock::status_t (*status)(void*),
+			void (*destroy)(void*), void (*finalize)(void*), void *context)
+		{
+			if (_pending.size() == _pending.capacity()) _pending.reserve(std::max<size_t>(2*_pending.capacity(), 8)); // push_back mustn't throw once registered
+			std::unique_ptr<_entry> e(new _entry(this, subject, destroy, finalize, context));
+			if (!notify(subject, *e))
+			{
+				if (status(subject) == life_lock::retired) throw std::runtime_error("life_lock was retired before life_lock_eventfd::retire");
+				_entry::_on_expired(e.get()); // already expired or empty
+			}
+			_pending.push_back(std::move(e));
+		}
+
+		int                                  _fd;
+		std::atomic<size_t>                  _signalling; // listeners between firing and writing
+		std::vector<std::unique_ptr<_entry>> _pending;
+	};
+}
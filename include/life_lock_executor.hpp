@@ -0,0 +1,234 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <condition_variable>
+#include <life_lock.hpp>
+
+
+/*
+	life_lock_executor is a thread pool whose tasks may be bound to objects
+		through weak pointers (std::weak_ptr or gated_weak_ptr).
+
+	Before running a bound task, a worker checks whether its target has expired,
+		which is a plain load of the control block's use count.  Tasks for
+		objects already destroyed are discarded without the read-modify-write
+		of weak_ptr::lock(); only tasks for live targets lock them, and
+		a retired target's gated_weak_ptr still refuses to lock.
+
+	Each worker keeps a work-stealing deque of the tasks it posts, and idle
+		workers steal from the others, so tasks (and the control blocks they lock)
+		spread across threads.  Tasks posted from other threads, or which don't
+		fit in a deque, go to a shared queue.
+
+	Tasks must not throw.
+*/
+
+
+namespace edb
+{
+	namespace detail
+	{
+		struct executor_task
+		{
+			virtual ~executor_task() {}
+			virtual bool expired() const noexcept    {return false;}
+			virtual void run() = 0;
+		};
+
+		template<class F>
+		struct plain_task : executor_task
+		{
+			F f;
+			template<class G>
+			explicit plain_task(G &&g)    : f(std::forward<G>(g)) {}
+			void run() override           {f();}
+		};
+
+		template<class Weak, class F>
+		struct bound_task : executor_task
+		{
+			Weak target;
+			F    f;
+			template<class G>
+			bound_task(Weak &&target, G &&g)          : target(std::move(target)), f(std::forward<G>(g)) {}
+			bool expired() const noexcept override    {return target.expired();}
+			void run() override                       {if (auto p = target.lock()) f(*p);}
+		};
+
+		/*
+			A bounded work-stealing deque (Chase and Lev).
+				The owner pushes and pops at the bottom; thieves take from the top.
+		*/
+		class steal_deque
+		{
+		public:
+			explicit steal_deque(size_t capacity)    : _top(0), _bottom(0), _mask(capacity-1), _buf(new std::atomic<executor_task*>[capacity]) {}
+
+			// Owner only.  Fails if the deque is full.
+			bool push(executor_task *task) noexcept
+			{
+				int64_t b = _bottom.load(std::memory_order_relaxed), t = _top.load(std::memory_order_acquire);
+				if (b - t > int64_t(_mask)) return false;
+				_buf[size_t(b) & _mask].store(task, std::memory_order_relaxed);
+				_bottom.store(b + 1, std::memory_order_release);
+				return true;
+			}
+
+			// Owner only.
+			executor_task *pop() noexcept
+			{
+				int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+				_bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = _top.load(std::memory_order_relaxed);
+				if (t > b) {_bottom.store(b + 1, std::memory_order_relaxed); return nullptr;}
+
+				executor_task *task = _buf[size_t(b) & _mask].load(std::memory_order_relaxed);
+				if (t == b)
+				{
+					// The last task; race thieves for it.
+					if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) task = nullptr;
+					_bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return task;
+			}
+
+			// Any thread.  May fail spuriously when racing another thief.
+			executor_task *steal() noexcept
+			{
+				int64_t t = _top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t b = _bottom.load(std::memory_order_acquire);
+				if (t >= b) return nullptr;
+				executor_task *task = _buf[size_t(t) & _mask].load(std::memory_order_relaxed);
+				return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) ? task : nullptr;
+			}
+
+		private:
+			std::atomic<int64_t>                           _top;
+			char                                           _pad[LIFE_LOCK_CACHE_LINE]; // keeps thieves off the owner's cache line
+			std::atomic<int64_t>                           _bottom;
+			const size_t                                   _mask;
+			std::unique_ptr<std::atomic<executor_task*>[]> _buf;
+		};
+	}
+
+
+	class life_lock_executor
+	{
+	public:
+		/*
+			Start a pool of worker threads, each with a deque of the given capacity
+				(rounded up to a power of two).
+		*/
+		explicit life_lock_executor(size_t threads = std::thread::hardware_concurrency(), size_t deque_capacity = 1024)
+			:
+			_pending(0), _sleeping(0), _discarded(0), _stop(false)
+		{
+			if (!threads) threads = 1;
+			size_t cap = 1; while (cap < deque_capacity) cap *= 2;
+			for (size_t i = 0; i < threads; ++i) _deques.emplace_back(new detail::steal_deque(cap));
+			for (size_t i = 0; i < threads; ++i) _workers.emplace_back([this, i]() {_work(i);});
+		}
+
+		// Run every task already posted, then stop the workers.
+		~life_lock_executor()
+		{
+			{
+				std::lock_guard<std::mutex> guard(_mutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (auto &w : _workers) w.join();
+		}
+
+		life_lock_executor(const life_lock_executor&) = delete;
+		life_lock_executor &operator=(const life_lock_executor&) = delete;
+
+		// Post a task, called as f().
+		template<class F>
+		void post(F &&f)                                                 {_post(new detail::plain_task<typename std::decay<F>::type>(std::forward<F>(f)));}
+
+		/*
+			Post a task bound to a target, called as f(T&) with the target locked.
+				The task is discarded if the target has expired or can't be locked.
+		*/
+		template<class T, class F>
+		void post(std::weak_ptr<T> target, F &&f)                        {_post(new detail::bound_task<std::weak_ptr<T>, typename std::decay<F>::type>(std::move(target), std::forward<F>(f)));}
+		template<class T, class F>
+		void post(gated_weak_ptr<T> target, F &&f)                       {_post(new detail::bound_task<gated_weak_ptr<T>, typename std::decay<F>::type>(std::move(target), std::forward<F>(f)));}
+
+		size_t size()      const noexcept                                {return _workers.size();}
+
+		// The number of bound tasks discarded by the expiry check.
+		size_t discarded() const noexcept                                {return _discarded.load(std::memory_order_relaxed);}
+
+	private:
+		// The executor and deque index of the calling worker thread, if any.
+		struct _current_worker {life_lock_executor *pool; size_t index;};
+		static _current_worker &_current() noexcept                      {static thread_local _current_worker w = {nullptr, 0}; return w;}
+
+		void _post(detail::executor_task *task)
+		{
+			// Count the task before it becomes visible, so a worker can't take it first.
+			_pending.fetch_add(1, std::memory_order_seq_cst);
+			_current_worker &w = _current();
+			if (w.pool != this || !_deques[w.index]->push(task))
+			{
+				std::lock_guard<std::mutex> guard(_mutex);
+				try {_shared.push_back(task);}
+				catch (...) {_pending.fetch_sub(1, std::memory_order_relaxed); delete task; throw;}
+			}
+			// Wake a sleeping worker.  Pairs with the sleeper's increment of _sleeping.
+			if (_sleeping.load(std::memory_order_seq_cst))
+			{
+				std::lock_guard<std::mutex> guard(_mutex);
+				_wake.notify_one();
+			}
+		}
+
+		detail::executor_task *_take(size_t index)
+		{
+			if (auto *task = _deques[index]->pop()) return task;
+			{
+				std::lock_guard<std::mutex> guard(_mutex);
+				if (!_shared.empty()) {auto *task = _shared.front(); _shared.pop_front(); return task;}
+			}
+			for (size_t n = 1; n < _deques.size(); ++n)
+				if (auto *task = _deques[(index + n) % _deques.size()]->steal()) return task;
+			return nullptr;
+		}
+
+		void _work(size_t index)
+		{
+			_current() = _current_worker{this, index};
+			while (true)
+			{
+				if (detail::executor_task *task = _take(index))
+				{
+					_pending.fetch_sub(1, std::memory_order_relaxed);
+					if (task->expired()) _discarded.fetch_add(1, std::memory_order_relaxed);
+					else                 task->run();
+					delete task;
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(_mutex);
+				if (_stop && !_pending.load(std::memory_order_relaxed)) return;
+				_sleeping.fetch_add(1, std::memory_order_seq_cst);
+				_wake.wait_for(lock, std::chrono::milliseconds(10), [this]() {return _pending.load(std::memory_order_seq_cst) || _stop;});
+				_sleeping.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+
+		std::vector<std::unique_ptr<detail::steal_deque>> _deques;
+		std::vector<std::thread>                          _workers;
+		std::deque<detail::executor_task*>                _shared;
+		std::mutex                                        _mutex;
+		std::condition_variable                           _wake;
+		std::atomic<size_t>                               _pending, _sleeping, _discarded;
+		bool                                              _stop;
+	};
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+#include <life_lock.hpp>
+
+
+/*
+	life_lock_graveyard lets real-time threads dispose of life-locked objects
+		without ever blocking in destroy().
+
+	bury() retires a lock and hands it, with a function to finalize it, to a
+		bounded queue.  This is wait-free and allocation-free: the retired
+		shared reference is moved into the queue rather than released, so the
+		burying thread never runs the lock's deleter either.
+
+	A background reaper thread releases those references, waits for each lock
+		to expire and then calls its finalizer.  The reaper polls at an interval,
+		as waking it would require a system call from the burying thread.
+*/
+
+
+namespace edb
+{
+	class life_lock_graveyard
+	{
+	public:
+		/*
+			Start a graveyard holding up to capacity unreaped burials at a time.
+				The reaper checks for new burials and expirations at the given interval.
+		*/
+		explicit life_lock_graveyard(size_t capacity, std::chrono::microseconds interval = std::chrono::microseconds(1000))
+			:
+			_slots(new _slot[capacity]), _capacity(capacity), _head(0), _tail(0), _count(0), _pending_count(0), _stop(false), _interval(interval)
+		{
+			_pending.reserve(capacity);
+			_reaper = std::thread([this]() {_reap_loop();});
+		}
+
+		// Stop the reaper after every buried object has been finalized.
+		~life_lock_graveyard()
+		{
+			_stop.store(true, std::memory_order_release);
+			_reaper.join();
+		}
+
+		life_lock_graveyard(const life_lock_graveyard&) = delete;
+		life_lock_graveyard &operator=(const life_lock_graveyard&) = delete;
+
+		/*
+			Retire a life_lock and call finalize(context) from the reaper once it expires.
+				Typically finalize destroys the object containing the lock.
+				Returns false, leaving the lock untouched, if the graveyard is full.
+		*/
+		bool bury(life_lock &lock, void (*finalize)(void*), void *context) noexcept
+		{
+			return _bury(&lock, [](const void *l) {return static_cast<const life_lock*>(l)->status() != life_lock::retired;},
+				finalize, context, [](void *l) {return static_cast<life_lock*>(l)->retire();});
+		}
+
+		/*
+			Retire a life_locked object allocated with new, and delete it from the reaper.
+				Returns false, leaving the object untouched, if the graveyard is full.
+		*/
+		template<typename T, class Alloc, class Layout>
+		bool bury(life_locked<T, Alloc, Layout> *object) noexcept
+		{
+			using obj_t = life_locked<T, Alloc, Layout>;
+			return _bury(object, [](const void *o) {return static_cast<const obj_t*>(o)->status() != life_lock::retired;},
+				[](void *o) {delete static_cast<obj_t*>(o);}, object, [](void *o) {return static_cast<obj_t*>(o)->retire();});
+		}
+
+		// The number of burials not yet finalized, approximately.
+		size_t size() const noexcept    {return _count.load(std::memory_order_relaxed) + _pending_count.load(std::memory_order_relaxed);}
+
+	private:
+		struct _entry
+		{
+			std::shared_ptr<void> ref;
+			bool (*expired)(const void*);
+			const void *subject;
+			void (*finalize)(void*);
+			void *context;
+		};
+		struct _slot
+		{
+			std::atomic<bool> full {false};
+			_entry            entry;
+		};
+
+		bool _bury(void *subject, bool (*expired)(const void*), void (*finalize)(void*), void *context,
+			std::shared_ptr<void> (*retire)(void*)) noexcept
+		{
+			// Reserve space, then a slot.  Slots are freed in order, so the reserved slot is free.
+			if (_count.fetch_add(1, std::memory_order_acquire) >= _capacity)
+			{
+				_count.fetch_sub(1, std::memory_order_relaxed);
+				return false;
+			}
+			_slot &slot = _slots[_head.fetch_add(1, std::memory_order_relaxed) % _capacity];
+			slot.entry.ref      = retire(subject);
+			slot.entry.expired  = expired;
+			slot.entry.subject  = subject;
+			slot.entry.finalize = finalize;
+			slot.entry.context  = context;
+			slot.full.store(true, std::memory_order_release);
+			return true;
+		}
+
+		void _reap_loop()
+		{
+			while (true)
+			{
+				bool stopping = _stop.load(std::memory_order_acquire);
+
+				// Collect new burials in order, releasing their references here.
+				while (true)
+				{
+					_slot &slot = _slots[_tail % _capacity];
+					if (!slot.full.load(std::memory_order_acquire)) break;
+					_entry e = std::move(slot.entry);
+					slot.full.store(false, std::memory_order_relaxed);
+					++_tail;
+					_count.fetch_sub(1, std::memory_order_release);
+					e.ref.reset();
+					_pending.push_back(std::move(e));
+				}
+
+				// Finalize expired locks.
+				for (size_t i = 0; i < _pending.size();)
+				{
+					if (!_pending[i].expired(_pending[i].subject)) {++i; continue;}
+					_pending[i].finalize(_pending[i].context);
+					_pending[i] = std::move(_pending.back());
+					_pending.pop_back();
+				}
+				_pending_count.store(_pending.size(), std::memory_order_relaxed);
+
+				if (stopping && _pending.empty() && !_count.load(std::memory_order_acquire)) return;
+				std::this_thread::sleep_for(_interval);
+			}
+		}
+
+		std::unique_ptr<_slot[]>   _slots;
+		const size_t               _capacity;
+		std::atomic<size_t>        _head;
+		size_t                     _tail;     // reaper only
+		std::atomic<size_t>        _count;    // reserved or unreaped slots
+		std::atomic<size_t>        _pending_count;
+		std::atomic<bool>          _stop;
+		std::chrono::microseconds  _interval;
+		std::vector<_entry>        _pending;  // reaper only
+		std::thread                _reaper;
+	};
+}
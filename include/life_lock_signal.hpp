@@ -0,0 +1,199 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <life_locked_rcu.hpp>
+
+
+/*
+	life_lock_signal is a multicast signal whose slots call methods of objects
+		protected by life_locks, through gated weak pointers.
+
+	The slots are kept in an array published with life_locked_rcu, so dispatch
+		takes no mutex: it reads the current array and locks each slot's target.
+		A slot whose target is gone or retired is marked dead as it is found.
+		When dead slots make up half of the array, the dispatching thread compacts
+		it into a new version, if no other thread is modifying the signal.
+		Replaced arrays, and the weak pointers in them, are freed by the rcu
+		reclaimer as soon as the last dispatch reading them returns.
+
+	Subscribing appends to spare capacity in the current array, which readers
+		don't see until its size is published; the array is copied only when
+		it grows or is compacted.  Subscribing and unsubscribing take a mutex,
+		and are amortized O(1).
+*/
+
+
+namespace edb
+{
+	// Identifies a subscription to a life_lock_signal.
+	struct signal_connection
+	{
+		uint64_t id = 0;
+		explicit operator bool() const noexcept    {return id != 0;}
+	};
+
+
+	template<typename... Args>
+	class life_lock_signal
+	{
+	public:
+		explicit life_lock_signal(size_t capacity = 8)                   : _current_capacity(capacity < 1 ? 1 : capacity) {_tables.publish(_current_capacity); _current = _tables.read();}
+
+		life_lock_signal(const life_lock_signal&) = delete;
+		life_lock_signal &operator=(const life_lock_signal&) = delete;
+
+		/*
+			Subscribe a method of an object, or a function taking it as the first argument.
+				The slot is called as long as the object's lock is working.
+		*/
+		template<class T>
+		signal_connection subscribe(gated_weak_ptr<T> target, void (T::*method)(Args...))          {return _subscribe(std::move(target), method, &_call_method<T, decltype(method)>);}
+		template<class T>
+		signal_connection subscribe(gated_weak_ptr<T> target, void (T::*method)(Args...) const)    {return _subscribe(std::move(target), method, &_call_method<T, decltype(method)>);}
+		template<class T>
+		signal_connection subscribe(gated_weak_ptr<T> target, void (*function)(T&, Args...))       {return _subscribe(std::move(target), function, &_call_function<T>);}
+
+		// Remove a subscription.  Dispatches already in progress may still call it.
+		void unsubscribe(signal_connection connection)
+		{
+			std::lock_guard<std::mutex> guard(_writer);
+			auto pos = _index.find(connection.id);
+			if (pos == _index.end()) return;
+			if (!_current->entries[pos->second].dead.exchange(true, std::memory_order_relaxed))
+				_current->dead.fetch_add(1, std::memory_order_relaxed);
+			_index.erase(pos);
+			if (_wants_compaction(*_current)) _compact(false);
+		}
+
+		// Remove all subscriptions.
+		void clear()
+		{
+			std::lock_guard<std::mutex> guard(_writer);
+			_index.clear();
+			_current.reset();
+			_tables.publish(_current_capacity);
+			_current = _tables.read();
+		}
+
+		/*
+			Call every live slot with the given arguments.
+				Slots subscribed during dispatch may or may not be called.
+		*/
+		void operator()(Args... args) const
+		{
+			rcu_ptr<_table> table = _tables.read();
+			size_t n = table->size.load(std::memory_order_acquire), dead = 0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				_entry &e = table->entries[i];
+				if (e.dead.load(std::memory_order_relaxed)) continue;
+				if (std::shared_ptr<void> target = e.target.lock()) e.call(target.get(), e, args...);
+				else if (!e.dead.exchange(true, std::memory_order_relaxed)) ++dead;
+			}
+			if (dead)
+			{
+				table->dead.fetch_add(dead, std::memory_order_relaxed);
+				// Prune in a batch, unless another thread is busy with the signal.
+				if (_wants_compaction(*table) && _writer.try_lock())
+				{
+					std::lock_guard<std::mutex> guard(_writer, std::adopt_lock);
+					if (table.get() == _current.get()) const_cast<life_lock_signal*>(this)->_compact(true);
+				}
+			}
+		}
+
+		// The number of slots, including dead slots not yet pruned.
+		size_t size() const                                              {auto t = _tables.read(); return t->size.load(std::memory_order_acquire) - t->dead.load(std::memory_order_relaxed);}
+
+	private:
+		struct _entry
+		{
+			using method_storage = unsigned char[4 * sizeof(void*)];
+
+			gated_weak_ptr<void>  target;
+			void                (*call)(void*, const _entry&, Args...) = nullptr;
+			alignas(void*) method_storage method;
+			uint64_t              id = 0;
+			mutable std::atomic<bool> dead {false};
+
+			_entry() noexcept {}
+			_entry(const _entry &o) noexcept                             : target(o.target), call(o.call), id(o.id), dead(o.dead.load(std::memory_order_relaxed)) {std::memcpy(method, o.method, sizeof(method));}
+			_entry &operator=(const _entry &o) noexcept                  {target = o.target; call = o.call; id = o.id; dead.store(o.dead.load(std::memory_order_relaxed), std::memory_order_relaxed); std::memcpy(method, o.method, sizeof(method)); return *this;}
+		};
+
+		// One version of the slot array.  Entries beyond size are filled in by the writer.
+		struct _table
+		{
+			std::unique_ptr<_entry[]>   entries;
+			const size_t                capacity;
+			mutable std::atomic<size_t> size, dead;
+
+			explicit _table(size_t cap)                                  : entries(new _entry[cap]), capacity(cap), size(0), dead(0) {}
+
+			// Copy the live entries of another version.
+			_table(const _table &old, size_t cap)                        : entries(new _entry[cap]), capacity(cap), size(0), dead(0)
+			{
+				size_t n = old.size.load(std::memory_order_acquire), k = 0;
+				for (size_t i = 0; i < n; ++i) if (!old.entries[i].dead.load(std::memory_order_relaxed)) entries[k++] = old.entries[i];
+				size.store(k, std::memory_order_relaxed);
+			}
+		};
+
+		template<class T, class Method>
+		static void _call_method(void *object, const _entry &e, Args... args)
+		{
+			Method m; std::memcpy(&m, e.method, sizeof(m));
+			(static_cast<T*>(object)->*m)(args...);
+		}
+		template<class T>
+		static void _call_function(void *object, const _entry &e, Args... args)
+		{
+			void (*f)(T&, Args...); std::memcpy(&f, e.method, sizeof(f));
+			f(*static_cast<T*>(object), args...);
+		}
+
+		template<class T, class Method>
+		signal_connection _subscribe(gated_weak_ptr<T> &&target, Method method, void (*call)(void*, const _entry&, Args...))
+		{
+			static_assert(sizeof(Method) <= sizeof(typename _entry::method_storage), "method pointer is too large");
+			std::lock_guard<std::mutex> guard(_writer);
+			if (_current->size.load(std::memory_order_relaxed) == _current->capacity) _compact(false);
+
+			const _table &t = *_current;
+			size_t i = t.size.load(std::memory_order_relaxed);
+			_entry &e = t.entries[i];
+			e.target = gated_weak_ptr<void>(target);
+			e.call   = call;
+			e.id     = ++_last_id;
+			std::memcpy(e.method, &method, sizeof(method));
+			t.size.store(i + 1, std::memory_order_release);
+			_index.emplace(e.id, i);
+			return signal_connection{e.id};
+		}
+
+		static bool _wants_compaction(const _table &t) noexcept          {return 2 * t.dead.load(std::memory_order_relaxed) >= t.size.load(std::memory_order_relaxed) && t.size.load(std::memory_order_relaxed) >= 8;}
+
+		// Publish a compacted copy of the array, with room to grow.  Requires the writer mutex.
+		void _compact(bool from_dispatch)
+		{
+			const _table &old = *_current;
+			size_t live = old.size.load(std::memory_order_relaxed) - old.dead.load(std::memory_order_relaxed);
+			size_t cap = live < 4 ? 8 : 2 * live;
+			if (from_dispatch) {if (!_tables.try_publish(old, cap)) return;}
+			else               _tables.publish(old, cap);
+			_current = _tables.read();
+			_current_capacity = cap;
+
+			_index.clear();
+			for (size_t i = 0, n = _current->size.load(std::memory_order_relaxed); i < n; ++i) _index.emplace(_current->entries[i].id, i);
+		}
+
+		life_locked_rcu<_table>                _tables;
+		rcu_ptr<_table>                        _current;  // writer only
+		size_t                                 _current_capacity;
+		mutable std::mutex                     _writer;
+		std::unordered_map<uint64_t, size_t>   _index;    // connection to entry, for live entries
+		uint64_t                               _last_id = 0;
+	};
+}
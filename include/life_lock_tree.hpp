@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <life_lock.hpp>
+
+
+/*
+	life_lock_tree links the life_locks of a composite object's parts to a parent lock.
+
+	Child locks (life_lock, life_locked or another life_lock_tree) are adopted by
+		the tree.  Retiring the tree retires its own lock and every child in one
+		pass, attaching a listener to each child's deleter.  The listeners count
+		down a single word, so destroy() performs one combined wait, which lasts
+		as long as the slowest holder in the tree rather than the sum of waits.
+
+	Children must outlive the tree's destroy(), which destroys them too.
+		Adoption and destruction belong to the owning thread.
+*/
+
+
+namespace edb
+{
+	class life_lock_tree
+	{
+	public:
+		// Construct an uninitialized tree, or one whose own lock protects an object.
+		life_lock_tree() noexcept                                        : _pending(0), _state(_open), _retired(false), _listener(nullptr) {}
+		template<class T> life_lock_tree(T *ptr)                         : _lock(ptr), _pending(0), _state(_open), _retired(false), _listener(nullptr) {}
+		~life_lock_tree()                                                {destroy();}
+
+		life_lock_tree(const life_lock_tree&) = delete;
+		life_lock_tree &operator=(const life_lock_tree&) = delete;
+
+		// The tree's own lock, which protects the parent object.
+		life_lock       &root()       noexcept                           {return _lock;}
+		const life_lock &root() const noexcept                           {return _lock;}
+
+		template<class T> std::weak_ptr  <T> weak      (T *ptr) const    {return _lock.weak(ptr);}
+		template<class T> std::shared_ptr<T> lock      (T *ptr) const    {return _lock.lock(ptr);}
+		template<class T> gated_weak_ptr <T> gated_weak(T *ptr) const    {return _lock.gated_weak(ptr);}
+
+		/*
+			Register a child lock, which is retired and destroyed along with the tree.
+				Throws if the tree has already been retired.
+		*/
+		template<class Lockable>
+		void adopt(Lockable &child)
+		{
+			if (_retired) throw std::logic_error("life_lock_tree adopting after retirement");
+			_children.push_back(_node(this, &child,
+				[](void *c, expiration_listener &l) {return static_cast<Lockable*>(c)->retire_notify(l);},
+				[](void *c) {static_cast<Lockable*>(c)->destroy();}));
+		}
+
+		// The number of child locks adopted.
+		size_t size() const noexcept                                     {return _children.size();}
+
+		/*
+			Status of the whole tree.  Once retired, the tree is expired when
+				its own lock and every child lock have expired.
+		*/
+		life_lock::status_t status() const noexcept
+		{
+			if (!_retired) return _lock.status();
+			return (_state.load(std::memory_order_acquire) >= _opening) ? life_lock::expired : life_lock::retired;
+		}
+
+		// Retire the tree's own lock and every child.
+		void retire() noexcept                                           {_retire();}
+
+		/*
+			Retire the tree, wait for all of its locks to expire and destroy them.
+				Afterward, the tree is empty and has no children.
+				Return value indicates whether waiting was necessary.
+		*/
+		size_t destroy()
+		{
+			_retire();
+			size_t n = detail::await_word(_state, [](uint32_t s) {return s >= _opening;});
+			detail::poll_word(_state, [](uint32_t s) {return s == _open;}); // the last listener may still be notifying
+			_lock.destroy();
+			for (auto &c : _children) c.destroy(c.child); // children retired elsewhere may still wait here
+			_children.clear();
+			_retired = false;
+			_listener = nullptr;
+			return n;
+		}
+
+		// As life_lock::retire_notify, calling listener once the whole tree has expired.
+		bool retire_notify(expiration_listener &listener) noexcept
+		{
+			if (_retired) return false;
+			_listener = &listener;
+			_retire();
+			return true;
+		}
+
+	private:
+		struct _node : expiration_listener
+		{
+			life_lock_tree *tree;
+			void           *child;
+			bool          (*notify)(void*, expiration_listener&);
+			void          (*destroy)(void*);
+
+			_node(life_lock_tree *tree, void *child, bool (*notify)(void*, expiration_listener&), void (*destroy)(void*)) noexcept
+				:
+				expiration_listener{&_on_expired}, tree(tree), child(child), notify(notify), destroy(destroy) {}
+		};
+
+		void _retire() noexcept
+		{
+			if (_retired) return;
+			_retired = true;
+
+			// Count every lock first, so that early expirations can't reach zero.
+			_state.store(_counting, std::memory_order_relaxed);
+			_pending.store(_children.size() + 1, std::memory_order_relaxed);
+			for (auto &c : _children) if (!c.notify(c.child, c)) _on_expired(&c);
+			_root = _node(this, &_lock, nullptr, nullptr);
+			if (!_lock.retire_notify(_root)) _on_expired(&_root);
+		}
+
+		static void _on_expired(expiration_listener *self) noexcept
+		{
+			// As expiration_latch: once the tree is open it may be destroyed at any time.
+			life_lock_tree     *tree     = static_cast<_node*>(self)->tree;
+			expiration_listener *listener = tree->_listener;
+			if (tree->_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+			tree->_state.store(_opening, std::memory_order_release);
+#if LIFE_LOCK_CPP20
+			tree->_state.notify_all();
+#endif
+			tree->_state.store(_open, std::memory_order_release);
+			if (listener) listener->on_expired(listener);
+		}
+
+		enum : uint32_t {_counting, _opening, _open};
+
+		life_lock             _lock;
+		std::vector<_node>    _children;
+		_node                 _root {nullptr, nullptr, nullptr, nullptr};
+		std::atomic<size_t>   _pending;
+		std::atomic<uint32_t> _state;
+		bool                  _retired;
+		expiration_listener  *_listener;
+	};
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <life_lock.hpp>
+
+
+/*
+	life_locked_array stores many objects contiguously under a single life_lock.
+
+	A life_locked per element costs a control block allocation and 2-3 words each.
+		Here the elements share one control block, and each slot adds a 64-bit word
+		holding its status, a generation number and a count of its current holders.
+
+	Slots are emplaced, retired and destroyed individually by the owner.
+		Weak slot pointers may be locked from any thread, yielding a slot_ptr which
+		blocks destruction of that slot (and of the array) while it exists.
+*/
+
+
+namespace edb
+{
+	template<typename T>
+	class life_locked_array
+	{
+	public:
+		class slot_ptr;
+		class weak_slot_ptr;
+
+		using status_t = life_lock::status_t;
+
+		/*
+			Limits of the per-slot word.  Locking or copying a slot_ptr fails while a slot has max_holders holders.
+				A slot may be emplaced max_generations-1 times; generations never wrap.
+		*/
+		static const uint64_t max_holders     = (uint64_t(1) << 30) - 1;
+		static const uint64_t max_generations = (uint64_t(1) << 32);
+
+
+	public:
+		// Construct an array of n empty slots.
+		explicit life_locked_array(size_t n)                             : _size(n), _objs(new _storage[n]), _states(new _state_word[n]), _lock(this)
+		{
+			for (size_t i = 0; i < n; ++i) _states[i].store(0, std::memory_order_relaxed);
+		}
+
+		// Destroy all objects, waiting for their holders.
+		~life_locked_array() noexcept                                    {destroy(); _lock.destroy();}
+
+		life_locked_array(const life_locked_array&) = delete;
+		life_locked_array &operator=(const life_locked_array&) = delete;
+
+
+		size_t size() const noexcept                                     {return _size;}
+
+		/*
+			Construct an object in an empty slot.
+				Weak slot pointers taken before the slot was last emptied stay expired.
+				Throws if the slot is not empty, or has used up its generations.
+		*/
+		template<class... Args>
+		T &emplace(size_t i, Args&&... args)
+		{
+			uint64_t s = _states[i].load(std::memory_order_relaxed);
+			if (s & _flags) throw std::runtime_error("life_locked_array slot is not empty");
+			if (_gen(s) + 1 >= max_generations) throw std::runtime_error("life_locked_array slot has used up its generations");
+			T *obj = new (_ptr(i)) T(std::forward<Args>(args)...);
+			_states[i].store((_gen(s) + 1) << _gen_shift | _working, std::memory_order_release);
+			return *obj;
+		}
+
+		/*
+			Query the status of a slot, as with life_lock.
+				working -- the slot holds an object which may be locked.
+				retired -- the slot may not be locked, but holders remain.
+				expired -- the slot is retired and has no holders.
+				empty   -- the slot holds no object.
+		*/
+		status_t status(size_t i) const noexcept
+		{
+			uint64_t s = _states[i].load(std::memory_order_acquire);
+			if (s & _working) return life_lock::working;
+			if (s & _retired) return (s & _holders) ? life_lock::retired : life_lock::expired;
+			return life_lock::empty;
+		}
+		bool has_value(size_t i) const noexcept                          {return (_states[i].load(std::memory_order_acquire) & _flags) != 0;}
+
+		/*
+			Prevent a slot from being locked.  Existing holders are unaffected.
+				Returns true if the slot was working.
+		*/
+		bool retire(size_t i) noexcept
+		{
+			// Only the owner modifies the flags, so holders' counting can't interfere.
+			if (!(_states[i].load(std::memory_order_relaxed) & _working)) return false;
+			_states[i].fetch_xor(_working | _retired, std::memory_order_acq_rel);
+			return true;
+		}
+
+		/*
+			Retire a slot and destroy its object, waiting for holders to release it.
+				Return value indicates whether waiting was necessary.
+		*/
+		size_t destroy(size_t i)
+		{
+			retire(i);
+			if (!(_states[i].load(std::memory_order_relaxed) & _retired)) return 0;
+			size_t n = detail::await_word(_states[i], [](uint64_t s) {return (s & _holders) == 0;});
+			_ptr(i)->~T();
+			_states[i].store(_states[i].load(std::memory_order_relaxed) & ~_flags, std::memory_order_release);
+			return n;
+		}
+
+		// Retire all slots, then destroy them.  Returns the number of slots which required waiting.
+		size_t destroy()
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < _size; ++i) retire(i);
+			for (size_t i = 0; i < _size; ++i) n += (destroy(i) != 0);
+			return n;
+		}
+
+		/*
+			Get a weak pointer to a slot.
+				It may be locked until the slot is retired, and never again afterward.
+		*/
+		weak_slot_ptr weak(size_t i) const
+		{
+			return weak_slot_ptr(_lock.weak(_ptr(i)), &_states[i], _gen(_states[i].load(std::memory_order_relaxed)));
+		}
+
+		// Lock a slot directly.  Fails if the slot is not working.
+		slot_ptr lock(size_t i) const                                    {return weak(i).lock();}
+
+		/*
+			Visit each working slot as f(index, object), in order.
+				Only the compact status words are read for slots which are not working.
+				The owner may call this without locking; other threads should lock instead.
+		*/
+		template<class F>
+		void for_each_live(F &&f)
+		{
+			for (size_t i = 0; i < _size; ++i)
+				if (_states[i].load(std::memory_order_acquire) & _working) f(i, *_ptr(i));
+		}
+
+		// Raw access to the object in a slot, which must not be empty.
+		T       *raw_ptr(size_t i)       noexcept                        {return _ptr(i);}
+		const T *raw_ptr(size_t i) const noexcept                        {return _ptr(i);}
+		T       &operator[](size_t i)       noexcept                     {return *_ptr(i);}
+		const T &operator[](size_t i) const noexcept                     {return *_ptr(i);}
+
+
+	private:
+		using _state_word = std::atomic<uint64_t>;
+
+		// State word layout: holder count, generation number, then status flags.
+		static const uint64_t
+			_holders   = max_holders,
+			_gen_shift = 30,
+			_working   = uint64_t(1) << 62,
+			_retired   = uint64_t(1) << 63,
+			_flags     = _working | _retired;
+
+		static uint64_t _gen(uint64_t s) noexcept                        {return (s & ~_flags) >> _gen_shift;}
+
+		struct _storage {alignas(T) unsigned char bytes[sizeof(T)];};
+
+		T *_ptr(size_t i) const noexcept                                 {return reinterpret_cast<T*>(_objs[i].bytes);}
+
+		const size_t                  _size;
+		std::unique_ptr<_storage[]>   _objs;
+		std::unique_ptr<_state_word[]> _states;
+		life_lock                     _lock;
+	};
+
+
+	/*
+		A locked slot of a life_locked_array.
+			The slot's object won't be destroyed while this pointer exists.
+	*/
+	template<typename T>
+	class life_locked_array<T>::slot_ptr
+	{
+	public:
+		slot_ptr() noexcept                                              : _state(nullptr) {}
+		~slot_ptr() noexcept                                             {reset();}
+
+		slot_ptr(slot_ptr &&o) noexcept                                  : _ptr(std::move(o._ptr)), _state(o._state) {o._state = nullptr;}
+		slot_ptr(const slot_ptr &o) noexcept                             : _state(nullptr) {if (o._state && _hold(o._state)) {_ptr = o._ptr; _state = o._state;}}
+		slot_ptr &operator=(slot_ptr o) noexcept                         {std::swap(_ptr, o._ptr); std::swap(_state, o._state); return *this;}
+
+		void reset() noexcept
+		{
+			if (!_state) return;
+#if LIFE_LOCK_CPP20
+			// The last holder of a retired slot wakes its destroyer.
+			uint64_t s = _state->fetch_sub(1, std::memory_order_release);
+			if ((s & (_holders | _retired)) == (1 | _retired)) _state->notify_one();
+#else
+			_state->fetch_sub(1, std::memory_order_release);
+#endif
+			_state = nullptr;
+			_ptr.reset();
+		}
+
+		T *get()        const noexcept                                   {return _ptr.get();}
+		T *operator->() const noexcept                                   {return _ptr.get();}
+		T &operator*()  const noexcept                                   {return *_ptr;}
+		explicit operator bool() const noexcept                          {return _state != nullptr;}
+
+	private:
+		friend class weak_slot_ptr;
+		slot_ptr(std::shared_ptr<T> &&p, _state_word *state) noexcept    : _ptr(std::move(p)), _state(state) {}
+
+		// Count another holder of a slot we already hold, failing at max_holders like lock().
+		static bool _hold(_state_word *state) noexcept
+		{
+			uint64_t s = state->load(std::memory_order_relaxed);
+			do if ((s & _holders) == _holders) return false;
+			while (!state->compare_exchange_weak(s, s+1, std::memory_order_relaxed));
+			return true;
+		}
+
+		std::shared_ptr<T> _ptr;   // Keeps the array's storage alive.
+		_state_word       *_state;
+	};
+
+
+	/*
+		A weak pointer to a slot of a life_locked_array.
+			Locking fails once the slot is retired or the array is destroyed.
+	*/
+	template<typename T>
+	class life_locked_array<T>::weak_slot_ptr
+	{
+	public:
+		weak_slot_ptr() noexcept                                         : _state(nullptr), _gen(0) {}
+
+		slot_ptr lock() const noexcept
+		{
+			std::shared_ptr<T> p = _ptr.lock();
+			if (!p) return slot_ptr();
+
+			// The array's storage is now pinned; count ourselves as a holder of the slot.
+			uint64_t s = _state->load(std::memory_order_relaxed);
+			do
+			{
+				if ((s & ~_holders) != (_gen << _gen_shift | _working) || (s & _holders) == _holders) return slot_ptr();
+			}
+			while (!_state->compare_exchange_weak(s, s+1, std::memory_order_acquire, std::memory_order_relaxed));
+			return slot_ptr(std::move(p), _state);
+		}
+
+		bool expired() const noexcept                                    {return _ptr.expired();}
+		void reset()         noexcept                                    {_ptr.reset(); _state = nullptr;}
+
+	private:
+		friend class life_locked_array;
+		weak_slot_ptr(std::weak_ptr<T> &&p, _state_word *state, uint64_t gen) noexcept    : _ptr(std::move(p)), _state(state), _gen(gen) {}
+
+		std::weak_ptr<T> _ptr;
+		_state_word     *_state;
+		uint64_t         _gen;
+	};
+}
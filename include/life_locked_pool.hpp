@@ -0,0 +1,213 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <life_lock.hpp>
+
+
+/*
+	life_locked_pool hands out life_locked objects from preallocated storage.
+
+	Released objects are retired without waiting.  Their slots are recycled once
+		their locks expire, so churning objects never blocks the owner.
+		The locks' shared references are allocated from a recycling arena, so that
+		steady-state churn performs no heap allocations.
+*/
+
+
+namespace edb
+{
+	namespace detail
+	{
+		/*
+			Fixed-size blocks for shared references, recycled through a free list.
+				Blocks may be freed by any thread, but only allocated by one at a time.
+				The arena is deleted once the pool and all of its blocks are gone.
+		*/
+		class recycling_arena
+		{
+		public:
+			static const size_t block_size = 64;
+
+			explicit recycling_arena(size_t count)    : _blocks(new _block[count]), _count(count), _free(nullptr), _refs(1)
+			{
+				for (size_t i = count; i--;) {_blocks[i].next = _free.load(std::memory_order_relaxed); _free.store(&_blocks[i], std::memory_order_relaxed);}
+			}
+
+			bool owns(const void *p) const noexcept    {return std::less_equal<const void*>()(_blocks.get(), p) && std::less<const void*>()(p, _blocks.get() + _count);}
+
+			// Take a block from the free list, or nullptr if there are none left.
+			void *pop() noexcept
+			{
+				// There is only one popper, so the head can't be popped and pushed behind our back.
+				_block *b = _free.load(std::memory_order_acquire);
+				while (b && !_free.compare_exchange_weak(b, b->next, std::memory_order_acquire, std::memory_order_acquire)) {}
+				if (b) retain();
+				return b;
+			}
+
+			// Return a block from any thread.
+			void push(void *p) noexcept
+			{
+				_block *b = static_cast<_block*>(p);
+				b->next = _free.load(std::memory_order_relaxed);
+				while (!_free.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed)) {}
+				release();
+			}
+
+			void retain()  noexcept    {_refs.fetch_add(1, std::memory_order_relaxed);}
+			void release() noexcept    {if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;}
+
+		private:
+			union _block
+			{
+				_block *next;
+				alignas(std::max_align_t) unsigned char bytes[block_size];
+			};
+
+			std::unique_ptr<_block[]> _blocks;
+			const size_t              _count;
+			std::atomic<_block*>      _free;
+			std::atomic<size_t>       _refs; // the pool, plus each allocation in use
+		};
+
+		/*
+			Allocates from a recycling_arena, falling back on the heap for
+				allocations which don't fit a block or when the arena is exhausted.
+				Heap allocations hold the arena too, as deallocate must consult it.
+		*/
+		template<class T>
+		class recycling_allocator
+		{
+		public:
+			using value_type = T;
+
+			explicit recycling_allocator(recycling_arena *arena) noexcept                     : _arena(arena) {}
+			template<class U> recycling_allocator(const recycling_allocator<U> &o) noexcept    : _arena(o._arena) {}
+
+			T *allocate(size_t n)
+			{
+				void *p = (n*sizeof(T) <= recycling_arena::block_size && alignof(T) <= alignof(std::max_align_t)) ? _arena->pop() : nullptr;
+				if (p) return static_cast<T*>(p);
+				T *t = std::allocator<T>().allocate(n);
+				_arena->retain();
+				return t;
+			}
+			void deallocate(T *p, size_t n) noexcept
+			{
+				if (_arena->owns(p)) {_arena->push(p); return;}
+				std::allocator<T>().deallocate(p, n);
+				_arena->release();
+			}
+
+			template<class U> bool operator==(const recycling_allocator<U> &o) const noexcept    {return _arena == o._arena;}
+			template<class U> bool operator!=(const recycling_allocator<U> &o) const noexcept    {return _arena != o._arena;}
+
+		private:
+			template<class U> friend class recycling_allocator;
+			recycling_arena *_arena;
+		};
+	}
+
+
+	/*
+		A fixed-capacity pool of life_locked<T>.
+			acquire() constructs an object in a free slot, and release() retires it.
+			Retired slots are destroyed and reused once their locks have expired.
+
+		acquire, release and collect must not be called concurrently.
+			Weak and shared pointers to the objects may be used from any thread.
+	*/
+	template<typename T>
+	class life_locked_pool
+	{
+	public:
+		using allocator_type = detail::recycling_allocator<char>;
+		using slot           = life_locked<T, allocator_type>;
+
+	public:
+		/*
+			Construct a pool of the given capacity.
+				Each slot's shared reference lives until its last weak pointer is gone,
+				so the arena holds spare blocks for references outliving their slot.
+		*/
+		explicit life_locked_pool(size_t capacity, size_t blocks = 0)    : _capacity(capacity), _slots(new _storage[capacity]),
+			_arena(new detail::recycling_arena(blocks ? blocks : 2*capacity))
+		{
+			_free.reserve(capacity);
+			_pending.reserve(capacity);
+			for (size_t i = capacity; i--;) _free.push_back(new (&_slots[i]) slot(std::allocator_arg, allocator_type(_arena), life_locked_empty));
+		}
+
+		// Destroy all objects, waiting for their shared pointers to expire.
+		~life_locked_pool()
+		{
+			for (size_t i = 0; i < _capacity; ++i) _slot(i)->retire();
+			for (size_t i = 0; i < _capacity; ++i) _slot(i)->~slot();
+			_arena->release();
+		}
+
+		life_locked_pool(const life_locked_pool&) = delete;
+		life_locked_pool &operator=(const life_locked_pool&) = delete;
+
+		size_t capacity() const noexcept     {return _capacity;}
+		size_t available() const noexcept    {return _free.size();}
+		size_t pending() const noexcept      {return _pending.size();}
+
+		/*
+			Construct an object in a free slot, recycling expired slots if necessary.
+				Returns nullptr if every slot is in use or awaiting expiration.
+		*/
+		template<typename... Args>
+		slot *acquire(Args&&... args)
+		{
+			if (_free.empty()) collect();
+			if (_free.empty()) return nullptr;
+			slot *s = _free.back();
+			_free.pop_back();
+			try                   {s->emplace(std::forward<Args>(args)...);}
+			catch (...)           {_free.push_back(s); throw;}
+			return s;
+		}
+
+		/*
+			Retire an object acquired from this pool, without waiting.
+				Its slot will be reused after all shared pointers to it are gone.
+		*/
+		void release(slot *s) noexcept
+		{
+			s->retire();
+			_pending.push_back(s);
+		}
+
+		/*
+			Destroy released objects whose locks have expired, freeing their slots.
+				Returns the number of slots freed.
+		*/
+		size_t collect()
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < _pending.size();)
+			{
+				slot *s = _pending[i];
+				if (s->status() != life_lock::expired) {++i; continue;}
+				s->destroy(); // doesn't wait
+				_pending[i] = _pending.back();
+				_pending.pop_back();
+				_free.push_back(s);
+				++n;
+			}
+			return n;
+		}
+
+	private:
+		struct _storage {alignas(slot) unsigned char bytes[sizeof(slot)];};
+
+		slot *_slot(size_t i) noexcept    {return reinterpret_cast<slot*>(_slots[i].bytes);}
+
+		const size_t                _capacity;
+		std::unique_ptr<_storage[]> _slots;
+		detail::recycling_arena    *_arena;
+		std::vector<slot*>          _free, _pending;
+	};
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <life_lock.hpp>
+
+
+/*
+	life_locked_rcu holds the current version of an object which is read by many
+		threads and replaced from time to time, such as a configuration table.
+
+	publish() constructs a new version and makes it current, without waiting.
+		The previous version is retired: it may no longer be read, and it is
+		destroyed by an rcu_reclaimer thread as soon as its last reader is done.
+		Neither readers nor the publishing thread run T's destructor.
+
+	Versions live in a small ring of slots, each with a word holding its status
+		and a count of its readers.  A reader increments the count of the current
+		slot with a single fetch_add, and only retries if that version was both
+		replaced and destroyed in the meantime, or is still being published.
+		A version only becomes readable once current, so reads never go back
+		in time.  Releasing a reader is a single
+		fetch_sub.  The last reader of a retired version then wakes the reclaimers
+		through a process-wide word, never touching the slot again.  Without C++20
+		wait/notify (or with LIFE_LOCK_REALTIME) readers don't wake anyone, and the
+		reclaimer polls instead.
+
+	Versions don't each carry a life_lock, as pinning one would cost a shared_ptr
+		lock rather than one increment.  The container borrows life_lock's status
+		values and waiting strategy, and like life_locked, its destruction waits
+		for readers.
+
+	publish() waits only when every slot still holds a version in use.
+		Publishing and destruction belong to the owning thread.
+*/
+
+
+namespace edb
+{
+	template<typename T> class rcu_ptr;
+	template<typename T> class rcu_weak_ptr;
+
+	namespace detail
+	{
+		// Bumped whenever a retired version may have become reclaimable.
+		inline std::atomic<uint32_t> &rcu_epoch() noexcept               {static std::atomic<uint32_t> epoch(0); return epoch;}
+
+		inline void rcu_wake() noexcept
+		{
+			rcu_epoch().fetch_add(1, std::memory_order_release);
+#if LIFE_LOCK_CPP20
+			rcu_epoch().notify_all();
+#endif
+		}
+
+		template<typename T>
+		struct rcu_block
+		{
+			static const uint32_t
+				holders    = (uint32_t(1) << 29) - 1,
+				reclaiming = uint32_t(1) << 29,
+				stale      = uint32_t(1) << 30,
+				live       = uint32_t(1) << 31;
+
+			static const size_t none = ~size_t(0);
+
+			struct slot
+			{
+				std::atomic<uint32_t> state {0};
+				alignas(T) unsigned char obj[sizeof(T)];
+
+				T *ptr() noexcept    {return reinterpret_cast<T*>(obj);}
+			};
+
+			std::atomic<size_t>     current;
+			const size_t            count;
+			std::unique_ptr<slot[]> slots;
+
+			explicit rcu_block(size_t n)    : current(none), count(n), slots(new slot[n]) {}
+
+			// Take a reference to the current version, if any.
+			slot *acquire() noexcept
+			{
+				while (true)
+				{
+					size_t i = current.load(std::memory_order_acquire);
+					if (i == none) return nullptr;
+					uint32_t s = slots[i].state.fetch_add(1, std::memory_order_acquire);
+					if (s & live) return &slots[i];
+					slots[i].state.fetch_sub(1, std::memory_order_relaxed); // destroyed, or not yet live; try again
+				}
+			}
+
+			// Release a reference.  The last reader of a retired version wakes the reclaimers.
+			static void release(slot &sl) noexcept
+			{
+				uint32_t s = sl.state.fetch_sub(1, std::memory_order_release);
+				if ((s & (holders | stale)) == (1 | stale)) rcu_wake();
+			}
+
+			// Mark a version as retired, waking the reclaimers if it has no readers.  Owner only.
+			static void retire(slot &sl) noexcept
+			{
+				uint32_t s = sl.state.fetch_or(stale, std::memory_order_relaxed);
+				if (!(s & holders)) rcu_wake();
+			}
+
+			// Destroy a retired version unless it is being read.
+			static bool reclaim(slot &sl) noexcept
+			{
+				uint32_t s = live | stale;
+				if (!sl.state.compare_exchange_strong(s, reclaiming, std::memory_order_acquire, std::memory_order_relaxed)) return false;
+				sl.ptr()->~T(); // readers arriving now see the slot isn't live and back off
+				sl.state.fetch_and(~reclaiming, std::memory_order_release);
+				return true;
+			}
+
+			// Destroy every retired version without readers.
+			size_t collect() noexcept
+			{
+				size_t n = 0;
+				for (size_t i = 0; i < count; ++i) n += reclaim(slots[i]);
+				return n;
+			}
+		};
+	}
+
+
+	/*
+		A thread which destroys the retired versions of life_locked_rcu containers.
+			Containers use a shared reclaimer unless given their own, which must
+			outlive them.  One reclaimer may serve any number of containers, but
+			T's destructor must not construct or destroy one served by the same reclaimer.
+	*/
+	class rcu_reclaimer
+	{
+	public:
+		rcu_reclaimer()                                                  : _stop(false) {_thread = std::thread([this]() {_run();});}
+		~rcu_reclaimer()                                                 {_stop.store(true); detail::rcu_wake(); _thread.join();}
+
+		rcu_reclaimer(const rcu_reclaimer&) = delete;
+		rcu_reclaimer &operator=(const rcu_reclaimer&) = delete;
+
+		// The reclaimer used by default, started on first use.
+		static rcu_reclaimer &shared()                                   {static rcu_reclaimer reclaimer; return reclaimer;}
+
+	private:
+		template<typename T> friend class life_locked_rcu;
+
+		struct _client
+		{
+			void   *block;
+			size_t (*collect)(void*);
+		};
+
+		void _attach(void *block, size_t (*collect)(void*))              {std::lock_guard<std::mutex> guard(_mutex); _clients.push_back(_client{block, collect});}
+
+		// Once this returns, the reclaimer won't touch the block again.
+		void _detach(void *block)
+		{
+			std::lock_guard<std::mutex> guard(_mutex);
+			_clients.erase(std::find_if(_clients.begin(), _clients.end(), [&](const _client &c) {return c.block == block;}));
+		}
+
+		void _run()
+		{
+			auto &epoch = detail::rcu_epoch();
+			while (true)
+			{
+				// Read the epoch first, so that a wake during collection isn't missed.
+				uint32_t seen = epoch.load(std::memory_order_acquire);
+				if (_stop.load()) return;
+				{
+					std::lock_guard<std::mutex> guard(_mutex);
+					for (auto &c : _clients) c.collect(c.block);
+				}
+				detail::await_word(epoch, [seen](uint32_t e) {return e != seen;});
+			}
+		}
+
+		std::mutex           _mutex;
+		std::vector<_client> _clients;
+		std::atomic<bool>    _stop;
+		std::thread          _thread;
+	};
+
+
+	/*
+		A versioned object, whose readers always see the version current when they read.
+			Like life_locked, destruction waits until no version is being read.
+	*/
+	template<typename T>
+	class life_locked_rcu
+	{
+	public:
+		/*
+			Construct with no current version.  At most max_versions may exist at once.
+				Retired versions are destroyed by the given reclaimer.
+		*/
+		explicit life_locked_rcu(size_t max_versions = 4, rcu_reclaimer &reclaimer = rcu_reclaimer::shared())
+			:
+			_block(std::make_shared<_block_t>(max_versions < 2 ? 2 : max_versions)), _reclaimer(reclaimer)
+		{
+			_reclaimer._attach(_block.get(), [](void *b) {return static_cast<_block_t*>(b)->collect();});
+		}
+		~life_locked_rcu()                                               {destroy(); _reclaimer._detach(_block.get());}
+
+		life_locked_rcu(const life_locked_rcu&) = delete;
+		life_locked_rcu &operator=(const life_locked_rcu&) = delete;
+
+		/*
+			Construct a new version with T's constructor arguments and make it current.
+				The previous version is retired, to be destroyed by the reclaimer.
+				Waits only if every slot is in use.
+		*/
+		template<typename... Args>
+		void publish(Args&&... args)
+		{
+			size_t i;
+			while ((i = _free_slot()) == _block_t::none) std::this_thread::yield(); // every slot is in use
+			_publish(i, std::forward<Args>(args)...);
+		}
+
+		// As publish, but fail instead of waiting if every slot is in use.
+		template<typename... Args>
+		bool try_publish(Args&&... args)
+		{
+			size_t i = _free_slot();
+			if (i == _block_t::none) return false;
+			_publish(i, std::forward<Args>(args)...);
+			return true;
+		}
+
+		// Read the current version.  The pointer is empty if there is none.
+		rcu_ptr<T> read() const noexcept                                 {return rcu_ptr<T>(_block->acquire());}
+
+		// Get a weak pointer, which reads whichever version is current when locked.
+		rcu_weak_ptr<T> weak() const noexcept                            {return rcu_weak_ptr<T>(_block);}
+
+		/*
+			Query the status of the container, as with life_lock.
+				working -- a version is current.
+				retired -- no version is current, but old versions are not yet destroyed.
+				empty   -- no version exists.
+		*/
+		life_lock::status_t status() const noexcept
+		{
+			if (_block->current.load(std::memory_order_acquire) != _block_t::none) return life_lock::working;
+			return versions() ? life_lock::retired : life_lock::empty;
+		}
+		explicit operator bool() const noexcept                          {return status() == life_lock::working;}
+
+		// The number of versions not yet destroyed, including the current one.
+		size_t versions() const noexcept
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < _block->count; ++i) n += (_block->slots[i].state.load(std::memory_order_acquire) & (_block_t::live | _block_t::reclaiming)) != 0;
+			return n;
+		}
+
+		// Retire the current version, leaving none.  Existing readers are unaffected.
+		void retire() noexcept
+		{
+			size_t cur = _block->current.exchange(_block_t::none, std::memory_order_acq_rel);
+			if (cur != _block_t::none) _block_t::retire(_block->slots[cur]);
+		}
+
+		/*
+			Retire the current version and wait until every version is destroyed,
+				destroying those the reclaimer hasn't reached on this thread.
+				Readers only notify the reclaimer, so this polls.
+				Return value indicates whether waiting was necessary.
+		*/
+		size_t destroy()
+		{
+			retire();
+			size_t n = 0;
+			for (size_t i = 0; i < _block->count; ++i)
+			{
+				auto &sl = _block->slots[i];
+				while (sl.state.load(std::memory_order_acquire) & (_block_t::live | _block_t::reclaiming))
+				{
+					n += detail::poll_word(sl.state, [](uint32_t s) {return !(s & (_block_t::holders | _block_t::reclaiming));});
+					_block_t::reclaim(sl);
+				}
+			}
+			return n;
+		}
+
+	private:
+		using _block_t = detail::rcu_block<T>;
+
+		size_t _free_slot() const noexcept
+		{
+			auto &b = *_block;
+			size_t cur = b.current.load(std::memory_order_relaxed), i = cur;
+			for (size_t n = 0; n < b.count; ++n)
+			{
+				i = (i + 1) % b.count;
+				if (i != cur && b.slots[i].state.load(std::memory_order_acquire) == 0) return i;
+			}
+			return _block_t::none;
+		}
+
+		template<typename... Args>
+		void _publish(size_t i, Args&&... args)
+		{
+			auto &b = *_block;
+			new (b.slots[i].ptr()) T(std::forward<Args>(args)...);
+			size_t cur = b.current.exchange(i, std::memory_order_acq_rel);
+			b.slots[i].state.fetch_or(_block_t::live, std::memory_order_release); // only now, so a late reader can't see a version before it's current
+			if (cur != _block_t::none) _block_t::retire(b.slots[cur]);
+		}
+
+		std::shared_ptr<_block_t> _block;
+		rcu_reclaimer            &_reclaimer;
+	};
+
+
+	/*
+		A reference to one version of a life_locked_rcu.
+			The version won't be destroyed while this pointer exists.
+	*/
+	template<typename T>
+	class rcu_ptr
+	{
+	public:
+		rcu_ptr() noexcept                                               : _slot(nullptr) {}
+		~rcu_ptr() noexcept                                              {reset();}
+
+		rcu_ptr(rcu_ptr &&o) noexcept                                    : _slot(o._slot) {o._slot = nullptr;}
+		rcu_ptr(const rcu_ptr &o) noexcept                               : _slot(o._slot) {if (_slot) _slot->state.fetch_add(1, std::memory_order_relaxed);}
+		rcu_ptr &operator=(rcu_ptr o) noexcept                           {std::swap(_slot, o._slot); return *this;}
+
+		void reset() noexcept                                            {if (_slot) _block_t::release(*_slot); _slot = nullptr;}
+
+		const T *get()        const noexcept                             {return _slot ? _slot->ptr() : nullptr;}
+		const T *operator->() const noexcept                             {return _slot->ptr();}
+		const T &operator*()  const noexcept                             {return *_slot->ptr();}
+		explicit operator bool() const noexcept                          {return _slot != nullptr;}
+
+	private:
+		friend class life_locked_rcu<T>;
+		friend class rcu_weak_ptr<T>;
+		using _block_t = detail::rcu_block<T>;
+		explicit rcu_ptr(typename _block_t::slot *slot) noexcept         : _slot(slot) {}
+
+		typename _block_t::slot *_slot;
+	};
+
+
+	/*
+		A weak pointer to a life_locked_rcu.
+			Locking it reads the current version, and fails if there is none.
+	*/
+	template<typename T>
+	class rcu_weak_ptr
+	{
+	public:
+		rcu_weak_ptr() noexcept {}
+
+		rcu_ptr<T> lock() const noexcept                                 {return _block ? rcu_ptr<T>(_block->acquire()) : rcu_ptr<T>();}
+
+		bool expired() const noexcept                                    {return !_block || _block->current.load(std::memory_order_relaxed) == _block_t::none;}
+		void reset()         noexcept                                    {_block.reset();}
+
+	private:
+		friend class life_locked_rcu<T>;
+		using _block_t = detail::rcu_block<T>;
+		explicit rcu_weak_ptr(std::shared_ptr<_block_t> block) noexcept  : _block(std::move(block)) {}
+
+		std::shared_ptr<_block_t> _block;
+	};
+}
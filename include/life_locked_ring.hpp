@@ -0,0 +1,225 @@
+#pragma once
+
+#include <iterator>
+#include <algorithm>
+#include <life_lock.hpp>
+
+
+/*
+	life_locked_ring is a bounded lock-free queue with many producers and one
+		consumer, protected in the manner of a life_lock.  It generalizes the
+		pattern of senders locking a weak pointer to a receiver and submitting
+		items to it.
+
+	Senders hold a ring_sender, which keeps the ring's storage alive, so pushing
+		needs no reference count.  Instead, the ring's head index carries a closed
+		bit: retire() sets it, and producers claim cells with a compare-and-swap
+		on the head, which fails once the ring is closed.  destroy() then waits
+		for cells already claimed to be filled, and drains or discards them.
+
+	Pushing a range claims all of its cells with one compare-and-swap.
+		Copying or moving an item into the ring must not throw.
+*/
+
+
+namespace edb
+{
+	template<typename T> class ring_sender;
+
+	namespace detail
+	{
+		template<typename T>
+		struct mpsc_ring
+		{
+			static const size_t closed = ~(~size_t(0) >> 1);
+
+			struct cell
+			{
+				std::atomic<size_t> seq;  // equals the position when free, or position+1 when filled
+				alignas(T) unsigned char obj[sizeof(T)];
+
+				T *ptr() noexcept    {return reinterpret_cast<T*>(obj);}
+			};
+
+			alignas(LIFE_LOCK_CACHE_LINE) std::atomic<size_t> head;   // producers' position, and the closed bit
+			alignas(LIFE_LOCK_CACHE_LINE) std::atomic<size_t> tail;   // written by the consumer only
+			const size_t            mask;
+			std::unique_ptr<cell[]> cells;
+
+			explicit mpsc_ring(size_t capacity)    : head(0), tail(0), mask(capacity-1), cells(new cell[capacity])
+			{
+				for (size_t i = 0; i < capacity; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+			}
+			~mpsc_ring()    {discard(head.load(std::memory_order_relaxed) & ~closed);}
+
+			// Claim up to n cells, returning the first position and setting n to the number claimed.
+			bool claim(size_t &pos, size_t &n) noexcept
+			{
+				const size_t wanted = n;
+				size_t h = head.load(std::memory_order_relaxed);
+				while (true)
+				{
+					if (h & closed) return false;
+					size_t t = tail.load(std::memory_order_acquire);
+					if (t > h) {h = head.load(std::memory_order_relaxed); continue;} // h is stale
+					n = std::min(wanted, mask + 1 - (h - t));
+					if (!n) return false;
+					// Cells are freed in order, so if the last is free, all are.  If not, h is stale.
+					size_t last = h + n - 1;
+					if (cells[last & mask].seq.load(std::memory_order_acquire) != last) {h = head.load(std::memory_order_relaxed); continue;}
+					if (head.compare_exchange_weak(h, h + n, std::memory_order_relaxed, std::memory_order_relaxed)) {pos = h; return true;}
+				}
+			}
+			template<class U>
+			void fill(size_t pos, U &&value)    {cell &c = cells[pos & mask]; new (c.ptr()) T(std::forward<U>(value)); c.seq.store(pos + 1, std::memory_order_release);}
+
+			// Consume one item if available.  Consumer only.
+			template<class F>
+			bool pop(F &&f)
+			{
+				size_t t = tail.load(std::memory_order_relaxed);
+				cell &c = cells[t & mask];
+				if (c.seq.load(std::memory_order_acquire) != t + 1) return false;
+				_consume(c, t, f);
+				return true;
+			}
+
+			// Wait for claimed cells up to end to be filled, passing each item to f.
+			template<class F>
+			size_t drain_to(size_t end, F &&f)
+			{
+				size_t n = 0;
+				for (size_t t = tail.load(std::memory_order_relaxed); t != end; ++t)
+				{
+					cell &c = cells[t & mask];
+					n += detail::poll_word(c.seq, [t](size_t s) {return s == t + 1;});
+					_consume(c, t, f);
+				}
+				return n;
+			}
+			size_t discard(size_t end)    {return drain_to(end, [](T&&) {});}
+
+		private:
+			template<class F>
+			void _consume(cell &c, size_t t, F &f)
+			{
+				struct done
+				{
+					mpsc_ring &ring; cell &c; size_t t;
+					~done()    {c.ptr()->~T(); c.seq.store(t + ring.mask + 1, std::memory_order_release); ring.tail.store(t + 1, std::memory_order_release);}
+				}
+				guard {*this, c, t};
+				f(std::move(*c.ptr()));
+			}
+		};
+	}
+
+
+	/*
+		A bounded queue which many threads may push to through ring_sender.
+			The owner consumes from it, and like life_locked, destroying it
+			waits for any push in progress.
+	*/
+	template<typename T>
+	class life_locked_ring
+	{
+	public:
+		// Construct a ring holding at least capacity items (rounded up to a power of two).
+		explicit life_locked_ring(size_t capacity)                       : _ring(std::allocate_shared<_ring_t>(cache_aligned_allocator<_ring_t>(), _round(capacity))) {}
+		~life_locked_ring()                                              {destroy();}
+
+		life_locked_ring(const life_locked_ring&) = delete;
+		life_locked_ring &operator=(const life_locked_ring&) = delete;
+
+		size_t capacity() const noexcept                                 {return _ring->mask + 1;}
+
+		// Get a sender, which may push items until the ring is retired.
+		ring_sender<T> sender() const noexcept                           {return ring_sender<T>(_ring);}
+
+		// Consume one item, calling f(T&&).  Returns false if the ring is empty.
+		template<class F> bool try_pop(F &&f)                            {return _ring->pop(f);}
+		bool try_pop(T &out)                                             {return _ring->pop([&out](T &&v) {out = std::move(v);});}
+
+		// Consume up to max items as above.  Returns the number consumed.
+		template<class F>
+		size_t drain(F &&f, size_t max = ~size_t(0))
+		{
+			size_t n = 0;
+			while (n < max && _ring->pop(f)) ++n;
+			return n;
+		}
+
+		/*
+			Query the status of the ring, as with life_lock.
+				working -- senders may push.
+				retired -- senders may not push; items may remain.
+		*/
+		life_lock::status_t status() const noexcept                      {return (_ring->head.load(std::memory_order_acquire) & _ring_t::closed) ? life_lock::retired : life_lock::working;}
+		explicit operator bool() const noexcept                          {return status() == life_lock::working;}
+
+		// Close the ring to senders.  Pushes in progress may still complete.
+		void retire() noexcept                                           {_ring->head.fetch_or(_ring_t::closed, std::memory_order_acq_rel);}
+
+		/*
+			Retire the ring, wait for pushes in progress and discard the remaining items.
+				Return value indicates whether waiting was necessary.
+		*/
+		size_t destroy()                                                 {retire(); return _ring->discard(_end());}
+
+		// As destroy, but pass the remaining items to f(T&&) instead of discarding them.
+		template<class F>
+		size_t drain_and_destroy(F &&f)                                  {retire(); return _ring->drain_to(_end(), f);}
+
+	private:
+		using _ring_t = detail::mpsc_ring<T>;
+
+		size_t _end() const noexcept                                     {return _ring->head.load(std::memory_order_acquire) & ~_ring_t::closed;}
+		static size_t _round(size_t n) noexcept                          {size_t c = 1; while (c < n) c *= 2; return c;}
+
+		std::shared_ptr<_ring_t> _ring;
+	};
+
+
+	/*
+		A handle for pushing to a life_locked_ring, which may outlive the ring.
+			Each push fails once the ring is retired, or if it is full.
+	*/
+	template<typename T>
+	class ring_sender
+	{
+	public:
+		ring_sender() noexcept {}
+
+		// Push one item.  Returns false if the ring is full or retired.
+		template<class U>
+		bool try_push(U &&value)
+		{
+			size_t pos, n = 1;
+			if (!_ring || !_ring->claim(pos, n)) return false;
+			_ring->fill(pos, std::forward<U>(value));
+			return true;
+		}
+
+		/*
+			Push as many items from a range as fit, claiming their cells at once.
+				Returns the number of items pushed, which is zero if the ring is retired.
+		*/
+		template<class It>
+		size_t try_push(It first, It last)
+		{
+			size_t pos, n = size_t(std::distance(first, last));
+			if (!_ring || !n || !_ring->claim(pos, n)) return 0;
+			for (size_t i = 0; i < n; ++i, ++first) _ring->fill(pos + i, *first);
+			return n;
+		}
+
+		bool expired() const noexcept                                    {return !_ring || (_ring->head.load(std::memory_order_relaxed) & detail::mpsc_ring<T>::closed);}
+		void reset()         noexcept                                    {_ring.reset();}
+
+	private:
+		friend class life_locked_ring<T>;
+		explicit ring_sender(std::shared_ptr<detail::mpsc_ring<T>> ring) noexcept    : _ring(std::move(ring)) {}
+
+		std::shared_ptr<detail::mpsc_ring<T>> _ring;
+	};
+}
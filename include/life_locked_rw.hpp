@@ -0,0 +1,285 @@
+#pragma once
+
+#include <life_lock.hpp>
+
+
+/*
+	life_locked_rw combines a reader/writer lock with life_locked's protection.
+
+	A single state word holds the reader count, a writer bit and the object's status.
+		read() pins the object and grants shared access with one atomic operation,
+		write() grants exclusive access, and destroy() waits for both to finish.
+		This replaces the pairing of life_locked<T> with a separate shared_mutex.
+
+	Writers take precedence: once a writer is waiting, new readers wait for it.
+	Both read() and write() fail once the object is retired.
+
+	The state word is kept in a small shared block, held by weak pointers so that
+		they may be locked safely after the object is gone.  A new block is made
+		for each object emplaced, so old weak pointers stay expired.
+
+	Guards don't own the block.  A guard that must wake a waiting writer or
+		destroyer counts itself in the state word until it has done so, and
+		destroy() waits for that count to drain before releasing the block.
+*/
+
+
+namespace edb
+{
+	template<typename T> class rw_weak_ptr;
+	template<typename T> class rw_read_ptr;
+	template<typename T> class rw_write_ptr;
+
+	namespace detail
+	{
+		struct rw_state
+		{
+			using word = std::atomic<uint64_t>;
+
+			static const uint64_t
+				readers = (uint64_t(1) << 32) - 1,
+				waker   = uint64_t(1) << 32,
+				waking  = ((uint64_t(1) << 29) - 1) << 32, // guards still notifying
+				writer  = uint64_t(1) << 61,
+				working = uint64_t(1) << 62,
+				retired = uint64_t(1) << 63;
+
+			static void notify(word &state) noexcept
+			{
+#if LIFE_LOCK_CPP20
+				state.notify_all();
+#endif
+				(void) state;
+			}
+
+			// Replace the state with next(state), notifying afterward if wake(state).
+			template<class Next, class Wake>
+			static void release(word &state, Next next, Wake wake) noexcept
+			{
+				uint64_t s = state.load(std::memory_order_relaxed), n;
+				do n = next(s) + (wake(s) ? waker : 0);
+				while (!state.compare_exchange_weak(s, n, std::memory_order_release, std::memory_order_relaxed));
+				if (!wake(s)) return;
+				notify(state);
+				state.fetch_sub(waker, std::memory_order_release);
+			}
+
+			static bool read(word &state, bool wait)
+			{
+				uint64_t s = state.load(std::memory_order_relaxed);
+				while (true)
+				{
+					if (!(s & working)) return false;
+					if (s & writer)
+					{
+						if (!wait) return false;
+						await_word(state, [](uint64_t v) {return !(v & writer) || !(v & working);});
+						s = state.load(std::memory_order_relaxed);
+					}
+					else if (state.compare_exchange_weak(s, s+1, std::memory_order_acquire, std::memory_order_relaxed)) return true;
+				}
+			}
+			static void end_read(word &state) noexcept
+			{
+				// The last reader wakes a waiting writer or destroyer.
+				release(state, [](uint64_t s) {return s - 1;}, [](uint64_t s) {return (s & readers) == 1 && (s & (writer | retired));});
+			}
+
+			static bool write(word &state, bool wait)
+			{
+				// Claim the writer bit, keeping out new readers...
+				uint64_t s = state.load(std::memory_order_relaxed);
+				while (true)
+				{
+					if (!(s & working)) return false;
+					if (s & writer || (!wait && (s & readers)))
+					{
+						if (!wait) return false;
+						await_word(state, [](uint64_t v) {return !(v & writer) || !(v & working);});
+						s = state.load(std::memory_order_relaxed);
+					}
+					else if (state.compare_exchange_weak(s, s | writer, std::memory_order_acquire, std::memory_order_relaxed)) break;
+				}
+				// ...then wait for existing readers to leave.
+				await_word(state, [](uint64_t v) {return !(v & readers) || !(v & working);});
+				if (!(state.load(std::memory_order_acquire) & working))
+				{
+					end_write(state); // retired while waiting, even if the readers have since left
+					return false;
+				}
+				return true;
+			}
+			static void end_write(word &state) noexcept    {release(state, [](uint64_t s) {return s & ~writer;}, [](uint64_t) {return true;});}
+		};
+	}
+
+
+	/*
+		An object protected by a life_lock and a reader/writer lock in one word.
+			read() and write() return guards, which are empty if the object is retired.
+			Like life_locked, destruction waits for all guards to be released.
+	*/
+	template<typename T>
+	class life_locked_rw
+	{
+	public:
+		// Construct with T's constructor arguments.
+		template<typename... Args, typename = typename std::enable_if<!detail::life_locked_tagged<Args...>::value>::type>
+		life_locked_rw(Args&&... args)                                   {emplace(std::forward<Args>(args)...);}
+		life_locked_rw(life_locked_empty_t) noexcept                     {}
+		~life_locked_rw()                                                {destroy();}
+
+		life_locked_rw(const life_locked_rw&) = delete;
+		life_locked_rw &operator=(const life_locked_rw&) = delete;
+
+		// Destroy any contained object, then construct a new one.  Old weak pointers stay expired.
+		template<typename... Args>
+		T &emplace(Args&&... args)
+		{
+			destroy();
+			auto state = std::make_shared<_state_word>(0);
+			new (_t()) T (std::forward<Args>(args)...);
+			state->store(_rw::working, std::memory_order_release);
+			_state = std::move(state);
+			return *_t();
+		}
+
+		// Lock for shared or exclusive access, waiting for writers.  Fails if retired.
+		rw_read_ptr <T> read()  const                                    {return _state && _rw::read (*_state, true) ? rw_read_ptr <T>(_t(), _state.get()) : rw_read_ptr <T>();}
+		rw_write_ptr<T> write()                                          {return _state && _rw::write(*_state, true) ? rw_write_ptr<T>(_t(), _state.get()) : rw_write_ptr<T>();}
+
+		// As above, but fail instead of waiting.
+		rw_read_ptr <T> try_read()  const                                {return _state && _rw::read (*_state, false) ? rw_read_ptr <T>(_t(), _state.get()) : rw_read_ptr <T>();}
+		rw_write_ptr<T> try_write()                                      {return _state && _rw::write(*_state, false) ? rw_write_ptr<T>(_t(), _state.get()) : rw_write_ptr<T>();}
+
+		// Get a weak pointer, which may be locked for reading or writing.
+		rw_weak_ptr<T> weak()                                            {return rw_weak_ptr<T>(_state, _t());}
+
+		life_lock::status_t status() const noexcept
+		{
+			if (!_state) return life_lock::empty;
+			uint64_t s = _state->load(std::memory_order_acquire);
+			if (s & _rw::working) return life_lock::working;
+			return (s & (_rw::readers | _rw::writer | _rw::waking)) ? life_lock::retired : life_lock::expired;
+		}
+		bool has_value()         const noexcept                          {return bool(_state);}
+		explicit operator bool() const noexcept                          {return bool(_state);}
+
+		// Prevent further locking.  Current guards are unaffected.
+		void retire() noexcept
+		{
+			if (!_state || !(_state->load(std::memory_order_relaxed) & _rw::working)) return;
+			_state->fetch_xor(_rw::working | _rw::retired, std::memory_order_acq_rel);
+			_rw::notify(*_state);
+		}
+
+		/*
+			Retire, wait for all readers and writers, and destroy the object.
+				Return value indicates whether waiting was necessary.
+		*/
+		size_t destroy()
+		{
+			if (!_state) return 0;
+			retire();
+			size_t n = detail::await_word(*_state, [](uint64_t s) {return !(s & (_rw::readers | _rw::writer));});
+			detail::poll_word(*_state, [](uint64_t s) {return !(s & _rw::waking);}); // a guard may still be notifying
+			_t()->~T();
+			_state.reset();
+			return n;
+		}
+
+		// Access the object without locking, which is only safe in the absence of writers.
+		T       *raw_ptr()       noexcept                                {return _state ? _t() : nullptr;}
+		const T *raw_ptr() const noexcept                                {return _state ? _t() : nullptr;}
+
+	private:
+		using _rw         = detail::rw_state;
+		using _state_word = _rw::word;
+
+		alignas(T) char             _obj[sizeof(T)];
+		std::shared_ptr<_state_word> _state;
+
+		T *_t() const noexcept    {return const_cast<T*>(reinterpret_cast<const T*>(_obj));}
+	};
+
+
+	// Shared access to an object in a life_locked_rw.
+	template<typename T>
+	class rw_read_ptr
+	{
+	public:
+		rw_read_ptr() noexcept                                           : _ptr(nullptr), _state(nullptr) {}
+		~rw_read_ptr() noexcept                                          {reset();}
+		rw_read_ptr(rw_read_ptr &&o) noexcept                            : _ptr(o._ptr), _state(o._state) {o._ptr = nullptr; o._state = nullptr;}
+		rw_read_ptr &operator=(rw_read_ptr &&o) noexcept                 {reset(); std::swap(_ptr, o._ptr); std::swap(_state, o._state); return *this;}
+
+		void reset() noexcept                                            {if (_state) detail::rw_state::end_read(*_state); _ptr = nullptr; _state = nullptr;}
+
+		const T *get()        const noexcept                             {return _ptr;}
+		const T *operator->() const noexcept                             {return _ptr;}
+		const T &operator*()  const noexcept                             {return *_ptr;}
+		explicit operator bool() const noexcept                          {return _ptr != nullptr;}
+
+	private:
+		friend class life_locked_rw<T>;
+		friend class rw_weak_ptr<T>;
+		rw_read_ptr(const T *ptr, detail::rw_state::word *state) noexcept    : _ptr(ptr), _state(state) {}
+
+		const T                *_ptr;
+		detail::rw_state::word *_state;
+	};
+
+	// Exclusive access to an object in a life_locked_rw.
+	template<typename T>
+	class rw_write_ptr
+	{
+	public:
+		rw_write_ptr() noexcept                                          : _ptr(nullptr), _state(nullptr) {}
+		~rw_write_ptr() noexcept                                         {reset();}
+		rw_write_ptr(rw_write_ptr &&o) noexcept                          : _ptr(o._ptr), _state(o._state) {o._ptr = nullptr; o._state = nullptr;}
+		rw_write_ptr &operator=(rw_write_ptr &&o) noexcept               {reset(); std::swap(_ptr, o._ptr); std::swap(_state, o._state); return *this;}
+
+		void reset() noexcept                                            {if (_state) detail::rw_state::end_write(*_state); _ptr = nullptr; _state = nullptr;}
+
+		T *get()        const noexcept                                   {return _ptr;}
+		T *operator->() const noexcept                                   {return _ptr;}
+		T &operator*()  const noexcept                                   {return *_ptr;}
+		explicit operator bool() const noexcept                          {return _ptr != nullptr;}
+
+	private:
+		friend class life_locked_rw<T>;
+		friend class rw_weak_ptr<T>;
+		rw_write_ptr(T *ptr, detail::rw_state::word *state) noexcept     : _ptr(ptr), _state(state) {}
+
+		T                      *_ptr;
+		detail::rw_state::word *_state;
+	};
+
+
+	/*
+		A weak pointer to an object in a life_locked_rw.
+			Locking it for reading or writing fails once the object is retired.
+	*/
+	template<typename T>
+	class rw_weak_ptr
+	{
+	public:
+		rw_weak_ptr() noexcept                                           : _ptr(nullptr) {}
+
+		rw_read_ptr <T> read()      const                                {return _state && _rw::read (*_state, true)  ? rw_read_ptr <T>(_ptr, _state.get()) : rw_read_ptr <T>();}
+		rw_write_ptr<T> write()     const                                {return _state && _rw::write(*_state, true)  ? rw_write_ptr<T>(_ptr, _state.get()) : rw_write_ptr<T>();}
+		rw_read_ptr <T> try_read()  const                                {return _state && _rw::read (*_state, false) ? rw_read_ptr <T>(_ptr, _state.get()) : rw_read_ptr <T>();}
+		rw_write_ptr<T> try_write() const                                {return _state && _rw::write(*_state, false) ? rw_write_ptr<T>(_ptr, _state.get()) : rw_write_ptr<T>();}
+
+		bool expired() const noexcept                                    {return !_state || !(_state->load(std::memory_order_relaxed) & _rw::working);}
+		void reset()         noexcept                                    {_state.reset(); _ptr = nullptr;}
+
+	private:
+		friend class life_locked_rw<T>;
+		using _rw = detail::rw_state;
+		rw_weak_ptr(std::shared_ptr<_rw::word> state, T *ptr) noexcept   : _state(std::move(state)), _ptr(ptr) {}
+
+		std::shared_ptr<_rw::word> _state;
+		T                         *_ptr;
+	};
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <life_lock.hpp>
+
+
+/*
+	life_locked_seq holds a small, trivially copyable object which readers copy
+		optimistically, in the manner of a seqlock, without taking a reference.
+
+	Writers make the sequence number odd while modifying the object.  Readers copy
+		the object and check that the sequence number was even and unchanged,
+		retrying otherwise.  A reader fails once the object has been retired.
+
+	The object is kept in a shared block along with its sequence number and status.
+		seq_weak_ptr keeps the block valid, so copying one costs a reference count,
+		but reading through it performs only loads.  Retiring and destroying the
+		object therefore never wait for readers.
+*/
+
+
+namespace edb
+{
+	template<typename T> class seq_weak_ptr;
+
+	namespace detail
+	{
+		template<typename T>
+		struct seq_block
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "life_locked_seq requires a trivially copyable type");
+
+			static const size_t word_count = (sizeof(T) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+			std::atomic<uintptr_t> seq;
+			std::atomic<uintptr_t> status;
+			std::atomic<uintptr_t> words[word_count];
+
+			explicit seq_block(const T &value) noexcept    : seq(0), status(life_lock::working) {store(value);}
+
+			// Begin and end a write.  Writers may be concurrent with each other.
+			uintptr_t begin_write() noexcept
+			{
+				uintptr_t s = seq.load(std::memory_order_relaxed);
+				while ((s & 1) || !seq.compare_exchange_weak(s, s+1, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					if (s & 1) {std::this_thread::yield(); s = seq.load(std::memory_order_relaxed);}
+				}
+				std::atomic_thread_fence(std::memory_order_release);
+				return s;
+			}
+			void end_write(uintptr_t s) noexcept    {seq.store(s+2, std::memory_order_release);}
+
+			// Copy the object out while writing, when no other writer can intervene.
+			T load_owned() const noexcept
+			{
+				uintptr_t buf[word_count];
+				for (size_t i = 0; i < word_count; ++i) buf[i] = words[i].load(std::memory_order_relaxed);
+				T value; std::memcpy(&value, buf, sizeof(T));
+				return value;
+			}
+			void store(const T &value) noexcept
+			{
+				uintptr_t buf[word_count] = {};
+				std::memcpy(buf, &value, sizeof(T));
+				for (size_t i = 0; i < word_count; ++i) words[i].store(buf[i], std::memory_order_relaxed);
+			}
+
+			// Copy a consistent snapshot, retrying while writes are in progress.
+			bool read(T &out) const noexcept
+			{
+				uintptr_t buf[word_count];
+				for (size_t tries = 1;; ++tries)
+				{
+					uintptr_t s = seq.load(std::memory_order_acquire);
+					if (!(s & 1))
+					{
+						uintptr_t st = status.load(std::memory_order_relaxed);
+						for (size_t i = 0; i < word_count; ++i) buf[i] = words[i].load(std::memory_order_relaxed);
+						std::atomic_thread_fence(std::memory_order_acquire);
+						if (seq.load(std::memory_order_relaxed) == s)
+						{
+							if (st != life_lock::working) return false;
+							std::memcpy(&out, buf, sizeof(T));
+							return true;
+						}
+					}
+					if (tries >= LIFE_LOCK_SPIN_COUNT) {std::this_thread::yield(); tries = 0;}
+				}
+			}
+		};
+	}
+
+
+	/*
+		A trivially copyable object which may be read without taking a reference.
+			write() and modify() publish new values; readers see whole values only.
+			Unlike life_locked, retire() and destroy() never wait.
+	*/
+	template<typename T>
+	class life_locked_seq
+	{
+	public:
+		// Construct with T's constructor arguments.
+		template<typename... Args>
+		life_locked_seq(Args&&... args)    : _block(std::make_shared<_block_t>(T(std::forward<Args>(args)...))) {}
+		~life_locked_seq()                 {destroy();}
+
+		life_locked_seq(const life_locked_seq&) = delete;
+		life_locked_seq &operator=(const life_locked_seq&) = delete;
+
+		// Publish a new value.
+		void write(const T &value) noexcept                        {uintptr_t s = _block->begin_write(); _block->store(value); _block->end_write(s);}
+
+		// Modify the value with f(T&), publishing the result.
+		template<class F>
+		void modify(F &&f)
+		{
+			uintptr_t s = _block->begin_write();
+			T value = _block->load_owned();
+			try      {f(value);}
+			catch (...) {_block->end_write(s); throw;}
+			_block->store(value);
+			_block->end_write(s);
+		}
+
+		/*
+			Call f(const T&) with a consistent snapshot of the value.
+				Returns false, without calling f, if the object has been retired.
+		*/
+		template<class F> bool try_read(F &&f) const               {T v; if (!_block->read(v)) return false; f(static_cast<const T&>(v)); return true;}
+		bool read_snapshot(T &out) const noexcept                  {return _block->read(out);}
+
+		// Get a weak pointer through which the value may be read.
+		seq_weak_ptr<T> weak() const noexcept                      {return seq_weak_ptr<T>(_block);}
+
+		life_lock::status_t status() const noexcept                {return life_lock::status_t(_block->status.load(std::memory_order_acquire));}
+		explicit operator bool() const noexcept                    {return status() == life_lock::working;}
+
+		// Prevent any further reads.  Reads already validated are unaffected.
+		void retire() noexcept
+		{
+			if (status() != life_lock::working) return;
+			uintptr_t s = _block->begin_write();
+			_block->status.store(life_lock::retired, std::memory_order_relaxed);
+			_block->end_write(s);
+		}
+
+		// As retire; readers hold no references, so there is nothing to wait for.
+		size_t destroy() noexcept                                  {retire(); _block->status.store(life_lock::expired, std::memory_order_relaxed); return 0;}
+
+	private:
+		using _block_t = detail::seq_block<T>;
+		std::shared_ptr<_block_t> _block;
+	};
+
+
+	/*
+		A weak pointer to a life_locked_seq, which reads snapshots of its value.
+	*/
+	template<typename T>
+	class seq_weak_ptr
+	{
+	public:
+		seq_weak_ptr() noexcept {}
+
+		template<class F> bool try_read(F &&f) const               {T v; if (!read_snapshot(v)) return false; f(static_cast<const T&>(v)); return true;}
+		bool read_snapshot(T &out) const noexcept                  {return _block && _block->read(out);}
+
+		bool expired() const noexcept                              {return !_block || _block->status.load(std::memory_order_relaxed) != life_lock::working;}
+		void reset()         noexcept                              {_block.reset();}
+
+	private:
+		friend class life_locked_seq<T>;
+		explicit seq_weak_ptr(std::shared_ptr<const detail::seq_block<T>> block) noexcept    : _block(std::move(block)) {}
+
+		std::shared_ptr<const detail::seq_block<T>> _block;
+	};
+}
@@ -84,7 +84,7 @@ namespace edb
 
 		// Create a shared_ptr or weak_ptr with the givens referent.
 		template<class Y> shared_ptr<Y> get_shared(Y *referent) const noexcept        {return shared_ptr<Y>(_cb, referent);}
-		template<class Y> weak_ptr  <Y> get_weak  (Y *referent) const noexcept        {return get_shared(referent);}
+		template<class Y> weak_ptr  <Y> get_weak  (Y *referent) const noexcept        {return get_shared(referent);}  // round-trips the strong count
 
 		// Release and return the strong reference.
 		template<class Y> shared_ptr<Y> release   (Y *referent)       noexcept        {return shared_ptr<Y>(std::move(_cb), referent);}
@@ -260,16 +260,16 @@ namespace edb
 			template<class Y> void _retain_weak  (const   weak_ptr<Y> &p) noexcept    {_buf b; new ((void*)&b)   weak_ptr<Y>(p);            _cb = b.control_block_ptr();}
 
 			// Unshrink to a shared_ptr or weak_ptr.
-			template<class Y> shared_ptr<Y> &_view_shared(_buf &b, Y *referent=0) const    {return b.set(_cb, referent).view<shared_ptr<Y>>();}
-			template<class Y> weak_ptr  <Y> &_view_weak  (_buf &b, Y *referent=0) const    {return b.set(_cb, referent).view<  weak_ptr<Y>>();}
+			template<class Y> shared_ptr<Y> &_view_shared(_buf &b, Y *referent=0) const    {return b.set(_cb, referent).template view<shared_ptr<Y>>();}
+			template<class Y> weak_ptr  <Y> &_view_weak  (_buf &b, Y *referent=0) const    {return b.set(_cb, referent).template view<  weak_ptr<Y>>();}
 
 			// Unshrink and transfer a shared_ptr or weak_ptr.
-			template<class Y> shared_ptr<Y> _release_shared(Y *referent)    {_buf b; shared_ptr<Y> p = std::move(b.set(_cb, referent).view<shared_ptr<Y>>()); _cb=0; return p;}
-			template<class Y> weak_ptr  <Y> _release_weak  (Y *referent)    {_buf b; weak_ptr  <Y> p = std::move(b.set(_cb, referent).view<  weak_ptr<Y>>()); _cb=0; return p;}
+			template<class Y> shared_ptr<Y> _release_shared(Y *referent)    {_buf b; shared_ptr<Y> p = std::move(b.set(_cb, referent).template view<shared_ptr<Y>>()); _cb=0; return p;}
+			template<class Y> weak_ptr  <Y> _release_weak  (Y *referent)    {_buf b; weak_ptr  <Y> p = std::move(b.set(_cb, referent).template view<  weak_ptr<Y>>()); _cb=0; return p;}
 
 			// Release as a shared_ptr or weak_ptr.
-			template<class Y = void> void _release_shared() noexcept   {_buf b; b.set(_cb).view<shared_ptr<Y>>().~shared_ptr(); _cb = nullptr;}
-			template<class Y = void> void _release_weak  () noexcept   {_buf b; b.set(_cb).view<  weak_ptr<Y>>().~weak_ptr();   _cb = nullptr;}
+			template<class Y = void> void _release_shared() noexcept   {_buf b; b.set(_cb).template view<shared_ptr<Y>>().~shared_ptr(); _cb = nullptr;}
+			template<class Y = void> void _release_weak  () noexcept   {_buf b; b.set(_cb).template view<  weak_ptr<Y>>().~weak_ptr();   _cb = nullptr;}
 			
 
 			void *_cb; // Control block
@@ -302,9 +302,10 @@ namespace edb
 		~shared_anchor() noexcept                                           {_release();}
 
 
-		// Produce pointers using the same management
+		// Produce pointers using the same management.
+		//    get_weak copies a weak view of the control block, touching only the weak count.
 		template<class Y> shared_ptr<Y> get_shared(Y *referent) const noexcept    {_buf b; return _view_shared<Y>(b,referent);}
-		template<class Y> weak_ptr  <Y> get_weak  (Y *referent) const noexcept    {_buf b; return _view_shared<Y>(b,referent);}
+		template<class Y> weak_ptr  <Y> get_weak  (Y *referent) const noexcept    {_buf b; return _view_weak  <Y>(b,referent);}
 
 
 		// Release and return the strong reference.
@@ -317,8 +318,8 @@ namespace edb
 		long                   use_count   ()                       const noexcept    {_buf b; return _view_shared<void>(b).use_count();}
 		bool                   owner_before(const shared_anchor &p) const noexcept    {_buf b,c; return _view_shared<void>(b).owner_before(p._view_shared<void>(c));}
 		bool                   owner_before(const weak_anchor   &p) const noexcept    {_buf b,c; return _view_shared<void>(b).owner_before(reinterpret_cast<const _ref&>(p)._view_shared<void>(c));}
-		template<class Y> bool owner_before(const shared_ptr<Y> &p) const noexcept    {_buf b; return _view_shared(b).owner_before(p);}
-		template<class Y> bool owner_before(const weak_ptr  <Y> &p) const noexcept    {_buf b; return _view_shared(b).owner_before(p);}
+		template<class Y> bool owner_before(const shared_ptr<Y> &p) const noexcept    {_buf b; return _view_shared<void>(b).owner_before(p);}
+		template<class Y> bool owner_before(const weak_ptr  <Y> &p) const noexcept    {_buf b; return _view_shared<void>(b).owner_before(p);}
 
 
 		// Move/copy with correct reference management
@@ -365,8 +366,8 @@ namespace edb
 		long                   use_count   ()                       const noexcept    {_buf b; return _view_weak<void>(b).use_count();}
 		bool                   owner_before(const shared_anchor &p) const noexcept    {_buf b,c; return _view_weak<void>(b).owner_before(p._view_shared<void>(c));}
 		bool                   owner_before(const weak_anchor   &p) const noexcept    {_buf b,c; return _view_weak<void>(b).owner_before(p._view_weak  <void>(c));}
-		template<class Y> bool owner_before(const shared_ptr<Y> &p) const noexcept    {_buf b; return _view_weak(b).owner_before(p);}
-		template<class Y> bool owner_before(const weak_ptr  <Y> &p) const noexcept    {_buf b; return _view_weak(b).owner_before(p);}
+		template<class Y> bool owner_before(const shared_ptr<Y> &p) const noexcept    {_buf b; return _view_weak<void>(b).owner_before(p);}
+		template<class Y> bool owner_before(const weak_ptr  <Y> &p) const noexcept    {_buf b; return _view_weak<void>(b).owner_before(p);}
 
 
 		// Move/copy with correct reference management
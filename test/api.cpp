@@ -0,0 +1,554 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <iterator>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <life_lock.hpp>
+
+
+/*
+	Behaviour tests for the life_lock and life_locked APIs.
+		Unlike the stress test in main.cpp, these run quickly and deterministically,
+		and are registered with ctest for each implementation and C++ standard.
+		The C++20 builds also cover stop tokens, pmr allocators and coroutines.
+*/
+
+
+static std::atomic<size_t> failures(0);
+
+static void Check(bool condition, const char *section, const char *expression, int line)
+{
+	if (condition) return;
+	++failures;
+	std::stringstream ss;
+	ss << "FAIL (" << section << "): " << expression << " at line " << line << std::endl;
+	std::cout << ss.str() << std::flush;
+}
+#define CHECK(condition) Check((condition), SECTION, #condition, __LINE__)
+
+
+using namespace std::chrono;
+
+struct Counted
+{
+	static std::atomic<int> alive;
+	int value;
+
+	Counted(int v = 0) : value(v) {++alive;}
+	~Counted()                    {--alive;}
+};
+std::atomic<int> Counted::alive(0);
+
+
+// weak_n issues many weak pointers from one strong-count round trip.
+static void TestWeakN()
+{
+	const char *SECTION = "weak_n";
+
+	int object;
+	edb::life_lock lock(&object);
+	long strong = lock.lock(&object).use_count();
+	std::vector<std::weak_ptr<int>> weak;
+	lock.weak_n(&object, 16, std::back_inserter(weak));
+	CHECK(weak.size() == 16);
+	for (auto &w : weak) CHECK(w.lock().get() == &object);
+	CHECK(lock.lock(&object).use_count() == strong);
+	lock.weak_n(&object, 0, std::back_inserter(weak));
+	CHECK(weak.size() == 16);
+
+	edb::life_locked<Counted> x(4);
+	std::vector<std::weak_ptr<Counted>> weakX(8);
+	x.weak_n(weakX.size(), weakX.begin());
+	for (auto &w : weakX) CHECK(w.lock() != nullptr && w.lock()->value == 4);
+
+	lock.destroy();
+	x.destroy();
+	for (auto &w : weak)  CHECK(w.expired() && !w.lock());
+	for (auto &w : weakX) CHECK(w.expired() && !w.lock());
+}
+
+// life_locked_lazy defers allocation until the first weak pointer, which many threads may race to create.
+static void TestLazyArming()
+{
+	const char *SECTION = "lazy arming";
+
+	for (int rep = 0; rep < 200; ++rep)
+	{
+		edb::life_locked<Counted> x(edb::life_locked_lazy, 7);
+		std::vector<std::weak_ptr<Counted>> weak(8);
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < weak.size(); ++i) threads.emplace_back([&, i]() {weak[i] = x.weak();});
+		for (auto &t : threads) t.join();
+
+		for (auto &w : weak) CHECK(w.lock() != nullptr && w.lock()->value == 7);
+		CHECK(x.weak().use_count() == 1); // every thread got the same control block
+		x.destroy();
+		for (auto &w : weak) CHECK(w.expired());
+	}
+
+	int object;
+	edb::life_lock lock;
+	lock.arm();
+	CHECK(lock.status() == edb::life_lock::armed);
+	auto weak = lock.weak(&object);
+	CHECK(lock.is_working());
+	lock.destroy();
+	CHECK(weak.expired());
+	CHECK(Counted::alive == 0);
+}
+
+// Gated weak pointers stop locking at retirement, while plain weak pointers continue.
+static void TestGatedWeak()
+{
+	const char *SECTION = "gated_weak";
+
+	edb::life_locked<Counted> x(3);
+	auto gated = x.gated_weak();
+	auto weak  = x.weak();
+	edb::gated_weak_ptr<const Counted> gatedConst = gated;
+
+	auto held = gated.lock();
+	CHECK(held && held->value == 3);
+	x.retire();
+	CHECK(x.has_value() && x.status() == edb::life_lock::retired);
+	CHECK(!gated.lock() && !gatedConst.lock());
+	CHECK(weak.lock() != nullptr);
+
+	std::thread releaser([&]() {std::this_thread::sleep_for(milliseconds(20)); held.reset();});
+	x.destroy();
+	releaser.join();
+	CHECK(!x.has_value() && gated.expired() && Counted::alive == 0);
+}
+
+// Retirement requests a stop from the stop token of gated weak pointers.
+static void TestStopToken()
+{
+	const char *SECTION = "stop_token";
+
+	edb::life_locked<Counted> x;
+	auto gated = x.gated_weak();
+	std::atomic<int> stage(0);
+	std::thread worker([&]()
+	{
+		auto p = gated.lock();
+		auto token = gated.stop_token();
+		stage = 1;
+		while (!token.stop_requested()) ++p->value;
+		stage = 2;
+	});
+	while (stage < 1) std::this_thread::yield();
+	CHECK(!x.stop_token().stop_requested());
+	x.destroy();
+	worker.join();
+	CHECK(stage == 2);
+	CHECK(!edb::life_stop_token().stop_requested());
+
+#if LIFE_LOCK_STOP_TOKEN
+	int object;
+	std::stop_source source;
+	edb::life_lock lock(&object, source);
+	auto token = edb::life_lock::get_stop_token(lock.lock(&object));
+	CHECK(token.stop_possible() && !token.stop_requested());
+	lock.retire();
+	CHECK(token.stop_requested());
+	lock.destroy();
+
+	edb::life_lock plain(&object);
+	CHECK(!edb::life_lock::get_stop_token(plain.lock(&object)).stop_possible());
+#endif
+}
+
+// Each renewal or emplacement is a new generation, which old weak pointers don't see.
+static void TestGenerations()
+{
+	const char *SECTION = "generations";
+
+	edb::life_locked<Counted> x(1);
+	auto first = x.weak();
+	Counted &second = x.emplace(2);
+	CHECK(second.value == 2 && Counted::alive == 1);
+	CHECK(first.expired() && x.weak().lock()->value == 2);
+
+	x.destroy();
+	x.emplace(3);
+	CHECK(x->value == 3);
+
+	int object;
+	edb::life_lock lock(&object);
+	auto a = lock.weak(&object);
+	lock.renew();
+	CHECK(a.expired());
+	auto b = lock.weak(&object);
+	CHECK(b.lock() != nullptr);
+	lock.renew(std::allocator<char>());
+	CHECK(b.expired() && lock.is_working());
+}
+
+template<class T>
+struct CountingAllocator
+{
+	using value_type = T;
+	int  *blocks;
+	bool *fail;
+
+	CountingAllocator(int *b, bool *f = nullptr) : blocks(b), fail(f) {}
+	template<class U> CountingAllocator(const CountingAllocator<U> &o) : blocks(o.blocks), fail(o.fail) {}
+
+	T   *allocate(size_t n)             {if (fail && *fail) throw std::bad_alloc(); ++*blocks; return std::allocator<T>().allocate(n);}
+	void deallocate(T *p, size_t n)     {--*blocks; std::allocator<T>().deallocate(p, n);}
+
+	template<class U> bool operator==(const CountingAllocator<U> &o) const    {return blocks == o.blocks;}
+	template<class U> bool operator!=(const CountingAllocator<U> &o) const    {return blocks != o.blocks;}
+};
+
+// life_locked control blocks come from the given allocator.
+static void TestAllocators()
+{
+	const char *SECTION = "allocators";
+
+	int blocks = 0;
+	{
+		using alloc = CountingAllocator<char>;
+		edb::life_locked<Counted, alloc> x(std::allocator_arg, alloc(&blocks), 5);
+		CHECK(blocks == 1 && x->value == 5);
+		auto weak = x.weak();
+		x.emplace(6);
+		CHECK(blocks == 2); // the old control block lives on with its weak pointer
+		weak.reset();
+		CHECK(blocks == 1);
+
+		edb::life_locked<Counted, alloc> lazy(std::allocator_arg, alloc(&blocks), edb::life_locked_lazy, 7);
+		CHECK(blocks == 1);
+		auto lazyWeak = lazy.weak();
+		CHECK(blocks == 2 && lazyWeak.lock()->value == 7);
+
+		edb::life_locked<Counted, alloc> empty(std::allocator_arg, alloc(&blocks), edb::life_locked_empty);
+		CHECK(!empty.has_value());
+
+		// Renewing an armed lock with an allocator uses it.
+		int object;
+		edb::life_lock lock;
+		lock.arm();
+		lock.renew(alloc(&blocks));
+		CHECK(lock.is_working() && blocks == 3);
+	}
+	CHECK(blocks == 0);
+
+	{
+		// An emplacement whose lock can't be allocated leaves no object behind.
+		bool fail = false;
+		edb::life_locked<Counted, CountingAllocator<char>> x(std::allocator_arg, CountingAllocator<char>(&blocks, &fail), 1);
+		fail = true;
+		bool threw = false;
+		try {x.emplace(2);} catch (std::bad_alloc&) {threw = true;}
+		CHECK(threw && !x.has_value() && Counted::alive == 0);
+	}
+	CHECK(blocks == 0);
+
+#if LIFE_LOCK_PMR
+	{
+		char buffer[4096];
+		std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+		edb::pmr::life_locked<Counted> a(std::allocator_arg, &arena, 1), b(std::allocator_arg, &arena, 2);
+		CHECK(a.weak().lock()->value == 1 && b.lock()->value == 2);
+	}
+#endif
+	CHECK(Counted::alive == 0);
+}
+
+// Records the blocks a cache_aligned_allocator hands out, whatever it's rebound to.
+static std::atomic<uintptr_t> recorded_block(0);
+static std::atomic<int>       recorded_live(0);
+
+template<class T>
+struct RecordingAllocator : edb::cache_aligned_allocator<T>
+{
+	RecordingAllocator() noexcept {}
+	template<class U> RecordingAllocator(const RecordingAllocator<U>&) noexcept {}
+
+	T   *allocate(size_t n)                      {T *p = edb::cache_aligned_allocator<T>::allocate(n); recorded_block = uintptr_t(p); ++recorded_live; return p;}
+	void deallocate(T *p, size_t n) noexcept    {--recorded_live; edb::cache_aligned_allocator<T>::deallocate(p, n);}
+};
+
+// The isolated layout and cache_aligned_allocator give the object and the shared reference lines of their own.
+static void TestIsolatedLayout()
+{
+	const char *SECTION = "isolated layout";
+	const uintptr_t line = LIFE_LOCK_CACHE_LINE;
+
+	{
+		using record = RecordingAllocator<char>;
+		edb::life_locked<Counted, record, edb::life_locked_isolated> x(8);
+		edb::life_locked<Counted, record, edb::life_locked_isolated> y(9); // its neighbour on the stack
+		auto weak = x.weak();
+		uintptr_t object = uintptr_t(x.raw_ptr()), block = recorded_block;
+		CHECK(weak.lock()->value == 8 && recorded_live == 2);
+		CHECK(object % line == 0 && block % line == 0);
+		CHECK(object / line != block / line);
+		CHECK(sizeof(x) >= 2 * line && alignof(decltype(x)) >= line);
+		CHECK(uintptr_t(y.raw_ptr()) % line == 0);
+	}
+	CHECK(recorded_live == 0);
+
+	// Blocks of any size round-trip through the allocator, each on its own lines.
+	edb::cache_aligned_allocator<uint32_t> alloc;
+	std::vector<uint32_t*> blocks;
+	for (size_t n = 1; n < 100; n += 7)
+	{
+		uint32_t *p = alloc.allocate(n);
+		CHECK(uintptr_t(p) % line == 0);
+		for (size_t i = 0; i < n; ++i) p[i] = uint32_t(n);
+		blocks.push_back(p);
+	}
+	for (size_t k = 0; k < blocks.size(); ++k)
+	{
+		size_t n = 1 + 7*k;
+		for (size_t i = 0; i < n; ++i) CHECK(blocks[k][i] == uint32_t(n));
+		alloc.deallocate(blocks[k], n);
+	}
+	CHECK(Counted::alive == 0);
+}
+
+// destroy(idle) runs the owner's work while waiting for holders.
+static void TestDestroyIdle()
+{
+	const char *SECTION = "destroy(idle)";
+
+	std::mutex mutex;
+	std::deque<std::function<void()>> queue;
+	auto runOne = [&]()
+	{
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			if (queue.empty()) return false;
+			task = std::move(queue.front());
+			queue.pop_front();
+		}
+		task();
+		return true;
+	};
+
+	int ran = 0;
+	{
+		edb::life_locked<Counted> x(5);
+		auto held = x.lock();
+		for (int i = 0; i < 100; ++i) queue.push_back([&]() {++ran;});
+		queue.push_back([&]() {held.reset();}); // the last task releases the reference
+		x.destroy(runOne);
+		CHECK(ran == 100 && !x.has_value());
+	}
+
+	int object;
+	edb::life_lock lock(&object);
+	auto held = lock.lock(&object);
+	std::thread releaser([&]() {std::this_thread::sleep_for(milliseconds(20)); held.reset();});
+	size_t idles = 0, n = lock.destroy([&]() {++idles; return false;});
+	releaser.join();
+	CHECK(n > 0 && idles > 0);
+	CHECK(lock.destroy() == 0);
+	CHECK(Counted::alive == 0);
+}
+
+// Any number of threads may wait for expiration, on the lock itself or through a latch.
+static void TestWaitExpired()
+{
+	const char *SECTION = "wait_expired";
+
+	{
+		int object;
+		edb::life_lock lock(&object);
+		auto held = lock.lock(&object);
+		CHECK(!lock.wait_expired_for(milliseconds(5)));
+
+		std::atomic<int> woke(0);
+		std::vector<std::thread> waiters;
+		for (int i = 0; i < 4; ++i) waiters.emplace_back([&]() {lock.wait_expired(); ++woke;});
+		lock.retire();
+		std::this_thread::sleep_for(milliseconds(10));
+		CHECK(woke == 0);
+		held.reset();
+		for (auto &t : waiters) t.join();
+		CHECK(woke == 4 && lock.wait_expired_for(milliseconds(0)));
+		lock.destroy();
+	}
+
+	for (int rep = 0; rep < 100; ++rep)
+	{
+		edb::expiration_latch latch;
+		auto *x = new edb::life_locked<Counted>();
+		auto held = x->lock();
+		std::atomic<int> woke(0);
+		std::vector<std::thread> waiters;
+		for (int i = 0; i < 3; ++i) waiters.emplace_back([&]() {latch.wait(); ++woke;});
+		waiters.emplace_back([&]() {while (!latch.wait_for(microseconds(50))) {} ++woke;});
+		latch.retire(*x);
+		std::thread releaser([&]() {held.reset();});
+		delete x;
+		releaser.join();
+		for (auto &t : waiters) t.join();
+		CHECK(woke == 4 && latch.expired());
+	}
+
+	{
+		edb::expiration_latch latch;
+		edb::life_locked<Counted> x;
+		latch.retire(x);
+		CHECK(latch.expired());
+		bool threw = false;
+		try {latch.retire(x);} catch (std::logic_error&) {threw = true;}
+		CHECK(threw);
+	}
+	CHECK(Counted::alive == 0);
+}
+
+
+#if LIFE_LOCK_COROUTINE
+
+struct Task
+{
+	struct promise_type
+	{
+		Task get_return_object()                   {return {};}
+		std::suspend_never initial_suspend()       {return {};}
+		std::suspend_never final_suspend() noexcept {return {};}
+		void return_void()                         {}
+		void unhandled_exception()                 {std::terminate();}
+	};
+};
+
+struct Resumer
+{
+	std::mutex                          *mutex;
+	std::deque<std::coroutine_handle<>> *queue;
+	void operator()(std::coroutine_handle<> h) const    {std::lock_guard<std::mutex> guard(*mutex); queue->push_back(h);}
+};
+
+static Task Teardown(edb::life_locked<Counted> &x, Resumer resumer, std::atomic<int> &stage)
+{
+	stage = 1;
+	co_await x.retire_and_wait(resumer);
+	stage = x.has_value() ? -1 : 2;
+}
+
+// retire_and_wait suspends a coroutine until the object is destroyed.
+static void TestRetireAndWait()
+{
+	const char *SECTION = "retire_and_wait";
+
+	std::mutex mutex;
+	std::deque<std::coroutine_handle<>> queue;
+	Resumer resumer{&mutex, &queue};
+	std::atomic<int> stage(0);
+	{
+		edb::life_locked<Counted> x;
+		auto held = x.lock();
+		Teardown(x, resumer, stage);
+		CHECK(stage == 1 && Counted::alive == 1);
+		std::thread releaser([&]() {held.reset();}); // the deleter schedules the coroutine
+		releaser.join();
+		CHECK(stage == 1 && queue.size() == 1);
+		queue.front().resume();
+		queue.pop_front();
+		CHECK(stage == 2 && Counted::alive == 0);
+	}
+	{
+		edb::life_locked<Counted> x;
+		Teardown(x, resumer, stage); // no holders: continues inline
+		CHECK(stage == 2 && queue.empty());
+	}
+	for (int rep = 0; rep < 500; ++rep)
+	{
+		edb::life_locked<Counted> x;
+		auto held = x.lock();
+		std::thread releaser([&]() {held.reset();});
+		Teardown(x, resumer, stage);
+		releaser.join();
+		while (stage != 2)
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			if (!queue.empty()) {queue.front().resume(); queue.pop_front();}
+		}
+	}
+	CHECK(Counted::alive == 0);
+}
+
+struct Pinned
+{
+	int            value = 0;
+	edb::life_lock lock;
+	Pinned() : lock(this) {}
+};
+
+struct Suspend
+{
+	std::deque<std::coroutine_handle<>> *queue;
+	bool await_ready()                             {return false;}
+	void await_suspend(std::coroutine_handle<> h)  {queue->push_back(h);}
+	int  await_resume()                            {return 42;}
+};
+
+static Task PinnedWorker(edb::gated_weak_ptr<Pinned> weak, std::deque<std::coroutine_handle<>> &queue, bool &gone)
+{
+	edb::life_pin<Pinned> pin(weak);
+	if (!pin) co_return;
+	while (true)
+	{
+		++pin->value;
+		int result = co_await pin.unpinned(Suspend{&queue});
+		if (!pin || result != 42) {gone = true; co_return;}
+	}
+}
+
+// life_pin releases its reference while the coroutine is suspended.
+static void TestLifePin()
+{
+	const char *SECTION = "life_pin";
+
+	std::deque<std::coroutine_handle<>> queue;
+	bool gone = false;
+	auto *x = new Pinned;
+	auto weak = x->lock.gated_weak(x);
+	PinnedWorker(weak, queue, gone);
+	CHECK(x->value == 1 && queue.size() == 1);
+	CHECK(weak.use_count() == 1); // only the lock itself
+	auto h = queue.front(); queue.pop_front(); h.resume();
+	CHECK(x->value == 2 && queue.size() == 1);
+	CHECK(x->lock.destroy() == 0); // no waiting: the suspended coroutine holds nothing
+	delete x;
+	h = queue.front(); queue.pop_front(); h.resume();
+	CHECK(gone && queue.empty());
+}
+
+#endif
+
+
+int main(int argc, char **argv)
+{
+	TestWeakN();
+	TestLazyArming();
+	TestGatedWeak();
+	TestStopToken();
+	TestGenerations();
+	TestAllocators();
+	TestIsolatedLayout();
+	TestDestroyIdle();
+	TestWaitExpired();
+#if LIFE_LOCK_COROUTINE
+	TestRetireAndWait();
+	TestLifePin();
+#endif
+
+	std::cout << (failures ? "FAILED" : "PASSED") << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <vector>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <life_lock.hpp>
+
+
+/*
+	Demonstrates false sharing between a life_locked object's hot fields and its lock.
+
+	Each sender repeatedly locks a gated weak pointer to a receiver (reading the lock's
+		status word) and submits an item (writing the receiver's item count), as in the
+		Sender/Receiver stress test.  In the "busy" variant the receiver also updates a
+		progress counter of its own, and senders only read from it.
+
+	With life_locked_packed the item count and the status word share a cache line;
+		with life_locked_isolated they do not.
+*/
+
+struct Receiver
+{
+	std::atomic<size_t> itemCount;
+	std::atomic<size_t> progress;
+	uint32_t            pattern;
+
+	Receiver() : itemCount(0), progress(0), pattern(0xFF) {}
+};
+
+using Clock = std::chrono::steady_clock;
+
+static const auto BENCH_TIME = std::chrono::milliseconds(500);
+
+
+template<class LifeLocked>
+double RunBench(unsigned senderCount, bool busyReceiver)
+{
+	LifeLocked receiver;
+	std::atomic<bool> stop(false);
+	std::vector<size_t> counts(senderCount * 8, 0); // spaced to avoid sharing between senders
+
+	std::vector<std::thread> senders;
+	for (unsigned i = 0; i < senderCount; ++i)
+	{
+		senders.emplace_back([&, i]()
+		{
+			auto weak = receiver.gated_weak();
+			size_t n = 0;
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				auto rcv = weak.lock();
+				if (!rcv) break;
+				if (busyReceiver) n += (rcv->pattern != 0);
+				else              {rcv->itemCount.fetch_add(1, std::memory_order_relaxed); ++n;}
+			}
+			counts[i*8] = n;
+		});
+	}
+
+	auto start = Clock::now();
+	if (busyReceiver)
+	{
+		while (Clock::now() - start < BENCH_TIME)
+			for (int i = 0; i < 1000; ++i) receiver->progress.fetch_add(1, std::memory_order_relaxed);
+	}
+	else std::this_thread::sleep_for(BENCH_TIME);
+	stop = true;
+
+	for (auto &thread : senders) thread.join();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	size_t total = 0;
+	for (unsigned i = 0; i < senderCount; ++i) total += counts[i*8];
+	return total / seconds / 1e6;
+}
+
+template<class LifeLocked>
+void Report(const char *name, unsigned senderCount)
+{
+	double submit = RunBench<LifeLocked>(senderCount, false);
+	double busy   = RunBench<LifeLocked>(senderCount, true);
+	std::cout << std::setw(28) << std::left << name
+		<< std::setw(12) << std::right << std::fixed << std::setprecision(2) << submit
+		<< std::setw(12) << busy << std::endl;
+}
+
+
+int main(int argc, char **argv)
+{
+	unsigned senderCount = std::max(2u, std::thread::hardware_concurrency() / 2);
+
+	std::cout << "sizeof packed:   " << sizeof(edb::life_locked<Receiver>) << std::endl;
+	std::cout << "sizeof isolated: " << sizeof(edb::life_locked<Receiver, std::allocator<char>, edb::life_locked_isolated>) << std::endl;
+	std::cout << senderCount << " senders; million locks per second:" << std::endl;
+	std::cout << std::setw(28) << std::left << "layout" << std::setw(12) << std::right << "submit" << std::setw(12) << "busy" << std::endl;
+
+	Report<edb::life_locked<Receiver>>
+		("packed", senderCount);
+	Report<edb::life_locked<Receiver, std::allocator<char>, edb::life_locked_isolated>>
+		("isolated", senderCount);
+	Report<edb::life_locked<Receiver, edb::cache_aligned_allocator<char>, edb::life_locked_isolated>>
+		("isolated + aligned counts", senderCount);
+}
@@ -0,0 +1,737 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <life_locked_array.hpp>
+#include <life_locked_pool.hpp>
+#include <life_lock_biased.hpp>
+#include <life_lock_asymmetric.hpp>
+#include <life_locked_seq.hpp>
+#include <life_locked_rw.hpp>
+#include <life_lock_graveyard.hpp>
+#include <life_lock_tree.hpp>
+#include <life_locked_rcu.hpp>
+#include <life_lock_signal.hpp>
+#include <life_locked_ring.hpp>
+#include <life_lock_executor.hpp>
+#ifdef __linux__
+	#include <poll.h>
+	#include <life_lock_eventfd.hpp>
+#endif
+
+
+/*
+	Behaviour tests for the components built on life_lock, one section per header.
+		Each section checks the component's contract in a single thread, then
+		races it against other threads briefly where it is designed for that.
+*/
+
+
+static std::atomic<size_t> failures(0);
+
+static void Check(bool condition, const char *section, const char *expression, int line)
+{
+	if (condition) return;
+	++failures;
+	std::stringstream ss;
+	ss << "FAIL (" << section << "): " << expression << " at line " << line << std::endl;
+	std::cout << ss.str() << std::flush;
+}
+#define CHECK(condition) Check((condition), SECTION, #condition, __LINE__)
+
+
+using namespace std::chrono;
+
+// Wait up to two seconds for work done by another thread.
+template<class Ready>
+static bool Eventually(Ready ready)
+{
+	for (int i = 0; i < 2000 && !ready(); ++i) std::this_thread::sleep_for(milliseconds(1));
+	return ready();
+}
+
+struct Counted
+{
+	static std::atomic<int> alive;
+	int value;
+
+	Counted(int v = 0) : value(v)      {++alive;}
+	Counted(const Counted &o) : value(o.value) {++alive;}
+	Counted &operator=(const Counted&) = default;
+	~Counted()                         {--alive;}
+};
+std::atomic<int> Counted::alive(0);
+
+// An object with its own life_lock, as in the README's examples.
+struct Locked
+{
+	std::atomic<int> hits;
+	edb::life_lock   lock;
+
+	Locked() : hits(0), lock(this) {}
+	void hit(int n) {hits += n;}
+};
+
+struct Part
+{
+	edb::life_lock lock;
+	Part() : lock(this) {}
+};
+
+static void TestArray()
+{
+	const char *SECTION = "life_locked_array";
+	{
+		edb::life_locked_array<Counted> array(100);
+		for (size_t i = 0; i < 100; ++i) array.emplace(i, int(i));
+		CHECK(Counted::alive == 100);
+
+		auto weak = array.weak(5);
+		{
+			auto p = weak.lock();
+			CHECK(p && p->value == 5 && array.status(5) == edb::life_lock::working);
+			array.retire(5);
+			CHECK(!weak.lock() && array.status(5) == edb::life_lock::retired);
+		}
+		CHECK(array.status(5) == edb::life_lock::expired);
+		array.destroy(5);
+		CHECK(array.status(5) == edb::life_lock::empty && Counted::alive == 99);
+
+		array.emplace(5, 55);
+		CHECK(!weak.lock()); // a new generation
+		CHECK(array.weak(5).lock()->value == 55);
+
+		size_t live = 0;
+		array.for_each_live([&](size_t, Counted&) {++live;});
+		CHECK(live == 100);
+
+		// Readers lock slots while the owner recycles them.
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 2; ++t) readers.emplace_back([&]()
+		{
+			for (size_t k = 0; !stop; ++k) if (auto p = array.weak(k % 100).lock()) CHECK(p->value == int(k % 100) || k % 100 == 5);
+		});
+		for (int r = 0; r < 100; ++r) for (size_t i = 0; i < 100; i += 7) {array.destroy(i); array.emplace(i, int(i));}
+		stop = true;
+		for (auto &t : readers) t.join();
+
+		auto held = array.lock(3), copy = held;
+		CHECK(copy && copy->value == 3);
+		copy.reset();
+		std::thread releaser([&]() {std::this_thread::sleep_for(milliseconds(20)); held.reset();});
+		CHECK(array.destroy(3) > 0);
+		releaser.join();
+	}
+	CHECK(Counted::alive == 0);
+}
+
+static void TestPool()
+{
+	const char *SECTION = "life_locked_pool";
+	{
+		edb::life_locked_pool<Counted> pool(4);
+		std::shared_ptr<Counted> held;
+		for (int r = 0; r < 1000; ++r)
+		{
+			auto *slot = pool.acquire();
+			CHECK(slot != nullptr);
+			if (!slot) break;
+			if (r == 10) held = slot->weak().lock();
+			pool.release(slot);
+		}
+		CHECK(pool.pending() >= 1); // the held slot can't be reused yet
+		held.reset();
+		pool.collect();
+		CHECK(pool.available() == 4);
+
+		std::vector<edb::life_locked_pool<Counted>::slot*> slots;
+		for (int i = 0; i < 4; ++i) slots.push_back(pool.acquire());
+		CHECK(!pool.acquire());
+		auto weak = slots[0]->weak();
+		pool.release(slots[0]);
+		CHECK(weak.expired());
+		for (size_t i = 1; i < slots.size(); ++i) pool.release(slots[i]);
+	}
+	{
+		// A reference that fell back on the heap may outlive the arena's last block.
+		std::weak_ptr<Counted> first, second;
+		{
+			edb::life_locked_pool<Counted> pool(1, 1);
+			auto *slot = pool.acquire(1);
+			first = slot->weak();
+			pool.release(slot);
+			slot = pool.acquire(2); // the arena's only block is still held
+			CHECK(slot && slot->raw_ptr()->value == 2);
+			second = slot->weak();
+			pool.release(slot);
+		}
+		first.reset();
+		second.reset();
+	}
+	CHECK(Counted::alive == 0);
+}
+
+struct Biased
+{
+	int                  value = 7;
+	edb::life_lock_biased lock {this};
+	~Biased() {lock.destroy();}
+};
+
+static void TestBiased()
+{
+	const char *SECTION = "life_lock_biased";
+
+	Biased b;
+	auto weak = b.lock.weak(&b);
+	{
+		auto a = b.lock.owner_lock(&b);
+		auto copy = a;
+		CHECK(a && a->value == 7 && b.lock.owner_count() == 2);
+	}
+	CHECK(b.lock.owner_count() == 0);
+
+	auto a = b.lock.owner_lock(&b);
+	bool threw = false;
+	try {b.lock.destroy();} catch (std::runtime_error&) {threw = true;}
+	CHECK(threw);
+
+	b.lock.retire();
+	CHECK(b.lock.status() == edb::life_lock::retired);
+	CHECK(!b.lock.owner_lock(&b) && !b.lock.gated_weak(&b).lock());
+	CHECK(weak.lock() != nullptr);
+	a.reset();
+	CHECK(b.lock.status() == edb::life_lock::expired);
+}
+
+struct Asymmetric
+{
+	std::atomic<int>         alive {1};
+	edb::life_lock_asymmetric lock {this};
+	~Asymmetric() {lock.destroy(); alive = 0;}
+};
+
+static void TestAsymmetric()
+{
+	const char *SECTION = "life_lock_asymmetric";
+	{
+		Asymmetric a;
+		auto weak = a.lock.weak(&a);
+		CHECK(weak.lock() && a.lock.weak(&a).lock());
+		a.lock.retire();
+		CHECK(!weak.lock() && weak.expired());
+	}
+
+	// Destruction waits for readers on other threads.
+	for (int round = 0; round < 50; ++round)
+	{
+		auto *a = new Asymmetric;
+		auto weak = a->lock.weak(a);
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 2; ++t) readers.emplace_back([&, weak]()
+		{
+			while (auto p = weak.lock()) CHECK(p->alive == 1);
+		});
+		std::this_thread::sleep_for(microseconds(200));
+		delete a;
+		for (auto &t : readers) t.join();
+	}
+}
+
+struct Stats {uint64_t a, b, c;};
+
+static void TestSeq()
+{
+	const char *SECTION = "life_locked_seq";
+
+	edb::life_locked_seq<Stats> seq(Stats{1, 1, 1});
+	Stats out;
+	CHECK(seq.read_snapshot(out) && out.a == 1 && out.c == 1);
+
+	auto weak = seq.weak();
+	std::atomic<bool> stop(false);
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 2; ++t) readers.emplace_back([&, weak]()
+	{
+		while (!stop && weak.try_read([&](const Stats &s) {CHECK(s.a == s.b && s.b == s.c);})) {}
+	});
+	for (uint64_t i = 2; i < 20000; ++i)
+	{
+		if (i & 1) seq.write(Stats{i, i, i});
+		else       seq.modify([](Stats &s) {++s.a; ++s.b; ++s.c;});
+	}
+	seq.retire();
+	stop = true;
+	for (auto &t : readers) t.join();
+	CHECK(!weak.read_snapshot(out) && weak.expired());
+}
+
+struct Pair {long a = 0, b = 0;};
+
+static void TestRW()
+{
+	const char *SECTION = "life_locked_rw";
+	{
+		edb::life_locked_rw<Pair> rw;
+		auto weak = rw.weak();
+		{
+			auto r = rw.read(), r2 = weak.read();
+			CHECK(r && r2 && !weak.try_write());
+		}
+		{
+			auto w = weak.write();
+			CHECK(w && !rw.try_read());
+			w->a = w->b = 1;
+		}
+
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 2; ++t) threads.emplace_back([&, weak]()
+		{
+			while (!stop) {auto r = weak.read(); if (!r) break; CHECK(r->a == r->b);}
+		});
+		threads.emplace_back([&, weak]()
+		{
+			while (!stop) {auto w = weak.write(); if (!w) break; ++w->a; ++w->b;}
+		});
+		std::this_thread::sleep_for(milliseconds(50));
+		rw.destroy();
+		for (auto &t : threads) t.join();
+		CHECK(rw.status() == edb::life_lock::empty && !weak.read() && !weak.write() && weak.expired());
+
+		rw.emplace();
+		CHECK(rw.read() && !weak.read());
+	}
+	{
+		// A writer waiting for readers fails once the object is retired.
+		edb::life_locked_rw<Pair> rw;
+		auto r = rw.read();
+		auto weak = rw.weak();
+		std::atomic<int> wrote(-1);
+		std::thread writer([&]() {wrote = bool(weak.write());});
+		std::this_thread::sleep_for(milliseconds(20));
+		rw.retire();
+		std::this_thread::sleep_for(milliseconds(20));
+		r.reset();
+		writer.join();
+		CHECK(wrote == 0);
+	}
+	for (int round = 0; round < 20; ++round)
+	{
+		// ...even if the readers leave before it notices.
+		edb::life_locked_rw<Pair> rw;
+		auto r = rw.read();
+		auto weak = rw.weak();
+		std::atomic<int> wrote(-1);
+		std::thread writer([&]() {wrote = bool(weak.write());});
+		std::this_thread::sleep_for(milliseconds(2));
+		rw.retire();
+		r.reset();
+		writer.join();
+		CHECK(wrote == 0);
+	}
+	// Guards released on other threads race with destruction.
+	for (int round = 0; round < 200; ++round)
+	{
+		auto *rw = new edb::life_locked_rw<Pair>();
+		auto r = rw->read();
+		std::thread reader([&]() {r.reset();});
+		delete rw;
+		reader.join();
+	}
+}
+
+static void TestGraveyard()
+{
+	const char *SECTION = "life_lock_graveyard";
+	{
+		edb::life_lock_graveyard yard(16, microseconds(200));
+		std::vector<edb::life_locked<Counted>*> objects;
+		for (int i = 0; i < 8; ++i) objects.push_back(new edb::life_locked<Counted>(i));
+		auto held = objects[3]->lock();
+
+		for (auto *o : objects) CHECK(yard.bury(o));
+		auto *locked = new Locked;
+		CHECK(yard.bury(locked->lock, [](void *p) {delete static_cast<Locked*>(p);}, locked));
+
+		std::this_thread::sleep_for(milliseconds(50));
+		CHECK(Counted::alive == 1); // still held
+		held.reset();
+	}
+	CHECK(Counted::alive == 0);
+}
+
+static void TestTree()
+{
+	const char *SECTION = "life_lock_tree";
+	{
+		Part parent;
+		edb::life_lock_tree tree(&parent);
+		std::vector<Part> parts(10);
+		edb::life_locked<Counted> object;
+		for (auto &p : parts) tree.adopt(p.lock);
+		tree.adopt(object);
+
+		Part nestedPart;
+		edb::life_lock_tree nested;
+		nested.adopt(nestedPart.lock);
+		tree.adopt(nested);
+		CHECK(tree.size() == 12);
+
+		auto parentRef = tree.lock(&parent);
+		auto partRef   = parts[2].lock.lock(&parts[2]);
+		auto nestedRef = nestedPart.lock.lock(&nestedPart);
+		auto gated     = parts[1].lock.gated_weak(&parts[1]);
+		tree.retire();
+		CHECK(!gated.lock() && parts[5].lock.status() == edb::life_lock::expired);
+		CHECK(tree.status() == edb::life_lock::retired && nested.status() == edb::life_lock::retired);
+
+		std::thread releaser([&]() {std::this_thread::sleep_for(milliseconds(20)); parentRef.reset(); partRef.reset(); nestedRef.reset();});
+		tree.destroy();
+		releaser.join();
+		CHECK(tree.status() == edb::life_lock::empty && tree.size() == 0 && !object.has_value());
+		for (auto &p : parts) CHECK(p.lock.status() == edb::life_lock::empty);
+		CHECK(nestedPart.lock.status() == edb::life_lock::empty);
+	}
+	// The last expiration races with destroy().
+	for (int round = 0; round < 200; ++round)
+	{
+		auto *tree = new edb::life_lock_tree;
+		std::vector<Part> parts(4);
+		std::vector<std::shared_ptr<Part>> held;
+		for (auto &p : parts) {tree->adopt(p.lock); held.push_back(p.lock.lock(&p));}
+		std::thread releaser([&]() {held.clear();});
+		delete tree;
+		releaser.join();
+	}
+	CHECK(Counted::alive == 0);
+}
+
+static void TestRCU()
+{
+	const char *SECTION = "life_locked_rcu";
+	{
+		edb::life_locked_rcu<Counted> rcu(3);
+		CHECK(!rcu.read() && rcu.status() == edb::life_lock::empty);
+		rcu.publish(1);
+		auto first = rcu.read();
+		rcu.publish(2);
+		CHECK(Counted::alive == 2 && first->value == 1 && rcu.read()->value == 2);
+		first.reset(); // the last reader of a retired version hands it to the reclaimer
+		CHECK(Eventually([&]() {return Counted::alive == 1;}) && rcu.versions() == 1);
+		rcu.publish(3);
+		CHECK(Eventually([&]() {return Counted::alive == 1;})); // as is a retired version nobody was reading
+
+		auto weak = rcu.weak();
+		CHECK(weak.lock()->value == 3);
+		rcu.retire();
+		CHECK(!weak.lock() && weak.expired());
+		CHECK(Eventually([&]() {return rcu.status() == edb::life_lock::empty;}));
+		rcu.publish(4);
+		CHECK(weak.lock()->value == 4);
+	}
+	{
+		edb::life_locked_rcu<Counted> rcu(4);
+		rcu.publish(0);
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 2; ++t) readers.emplace_back([&]()
+		{
+			auto weak = rcu.weak();
+			for (int last = 0; !stop;) if (auto p = weak.lock()) {CHECK(p->value >= last); last = p->value;}
+		});
+		for (int v = 1; v < 5000; ++v) rcu.publish(v);
+		stop = true;
+		for (auto &t : readers) t.join();
+	}
+	{
+		// Versions are destroyed on the reclaimer's thread, not by readers or the publisher.
+		static std::atomic<int> elsewhere(0), here(0);
+		struct Version
+		{
+			std::thread::id owner;
+			Version(std::thread::id id) : owner(id) {}
+			~Version() {++(std::this_thread::get_id() == owner ? here : elsewhere);}
+		};
+		edb::rcu_reclaimer reclaimer;
+		{
+			edb::life_locked_rcu<Version> rcu(2, reclaimer);
+			rcu.publish(std::this_thread::get_id());
+			for (int v = 0; v < 100; ++v)
+			{
+				auto p = rcu.read();
+				rcu.publish(std::this_thread::get_id());
+				std::thread([&]() {p.reset();}).join();
+			}
+			CHECK(Eventually([]() {return elsewhere == 100;}) && here == 0);
+		}
+		CHECK(elsewhere + here == 101);
+	}
+	{
+		// destroy() waits for readers.
+		auto *rcu = new edb::life_locked_rcu<Counted>();
+		rcu->publish(7);
+		auto p = rcu->read();
+		std::thread reader([&]() {std::this_thread::sleep_for(milliseconds(10)); p.reset();});
+		delete rcu;
+		reader.join();
+	}
+	CHECK(Counted::alive == 0);
+}
+
+static void Triple(Locked &l, int v) {l.hits += 3 * v;}
+
+// Counts the shared references of locks initialized with it, whatever it's rebound to.
+static std::atomic<int> references(0);
+
+template<class T>
+struct ReferenceAllocator
+{
+	using value_type = T;
+
+	ReferenceAllocator() noexcept {}
+	template<class U> ReferenceAllocator(const ReferenceAllocator<U>&) noexcept {}
+
+	T   *allocate(size_t n)                      {++references; return std::allocator<T>().allocate(n);}
+	void deallocate(T *p, size_t n) noexcept    {--references; std::allocator<T>().deallocate(p, n);}
+
+	template<class U> bool operator==(const ReferenceAllocator<U>&) const noexcept    {return true;}
+	template<class U> bool operator!=(const ReferenceAllocator<U>&) const noexcept    {return false;}
+};
+
+static void TestSignal()
+{
+	const char *SECTION = "life_lock_signal";
+	{
+		edb::life_lock_signal<int> signal;
+		Locked a, b, c;
+		auto connection = signal.subscribe(a.lock.gated_weak(&a), &Locked::hit);
+		signal.subscribe(b.lock.gated_weak(&b), &Locked::hit);
+		signal.subscribe(c.lock.gated_weak(&c), &Triple);
+		signal(2);
+		CHECK(a.hits == 2 && b.hits == 2 && c.hits == 6);
+		signal.unsubscribe(connection);
+		signal(1);
+		CHECK(a.hits == 2 && b.hits == 3);
+		b.lock.retire();
+		signal(1);
+		CHECK(b.hits == 3 && signal.size() == 1);
+	}
+	{
+		// A table pruned by dispatch is freed once dispatch is done with it, with its weak pointers.
+		edb::life_lock_signal<int> signal;
+		std::vector<std::unique_ptr<Locked>> observers;
+		for (int i = 0; i < 8; ++i)
+		{
+			observers.emplace_back(new Locked);
+			observers.back()->lock.renew(ReferenceAllocator<char>());
+			signal.subscribe(observers.back()->lock.gated_weak(observers.back().get()), &Locked::hit);
+		}
+		for (auto &o : observers) o->lock.destroy();
+		CHECK(references == 8); // held by the table
+		signal(1);
+		CHECK(signal.size() == 0);
+		CHECK(Eventually([]() {return references == 0;}));
+	}
+	{
+		// Dispatch races with subscription and the death of observers.
+		edb::life_lock_signal<int> signal;
+		std::vector<std::unique_ptr<Locked>> observers;
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> dispatchers;
+		for (int t = 0; t < 2; ++t) dispatchers.emplace_back([&]() {while (!stop) signal(1);});
+		for (int i = 0; i < 1000; ++i)
+		{
+			observers.emplace_back(new Locked);
+			signal.subscribe(observers.back()->lock.gated_weak(observers.back().get()), &Locked::hit);
+			if (i % 2) observers[i / 2].reset();
+		}
+		stop = true;
+		for (auto &t : dispatchers) t.join();
+		signal(1);
+		signal(1);
+		CHECK(signal.size() == 500);
+	}
+}
+
+static void TestRing()
+{
+	const char *SECTION = "life_locked_ring";
+	{
+		edb::life_locked_ring<Counted> ring(5);
+		CHECK(ring.capacity() == 8);
+		auto sender = ring.sender();
+		for (int i = 0; i < 8; ++i) CHECK(sender.try_push(Counted(i)));
+		CHECK(!sender.try_push(Counted(9)));
+
+		Counted out;
+		CHECK(ring.try_pop(out) && out.value == 0);
+		int expect = 1;
+		ring.drain([&](Counted &&c) {CHECK(c.value == expect); ++expect;});
+		CHECK(expect == 8);
+
+		std::vector<Counted> batch {Counted(10), Counted(11), Counted(12)};
+		CHECK(sender.try_push(batch.begin(), batch.end()) == 3);
+		ring.retire();
+		CHECK(!sender.try_push(Counted(1)) && sender.expired() && ring.status() == edb::life_lock::retired);
+		int left = 0;
+		ring.drain_and_destroy([&](Counted&&) {++left;});
+		CHECK(left == 3);
+	}
+	CHECK(Counted::alive == 0);
+
+	// Producers race with the consumer's destruction; nothing is lost or leaked.
+	for (int round = 0; round < 20; ++round)
+	{
+		auto *ring = new edb::life_locked_ring<Counted>(64);
+		std::atomic<long> pushed(0);
+		long popped = 0;
+		std::vector<std::thread> producers;
+		for (int t = 0; t < 2; ++t) producers.emplace_back([&, sender = ring->sender()]() mutable
+		{
+			while (!sender.expired()) if (sender.try_push(Counted(7))) ++pushed;
+		});
+		for (int k = 0; k < 500; ++k) popped += ring->drain([&](Counted &&c) {CHECK(c.value == 7);});
+		ring->drain_and_destroy([&](Counted&&) {++popped;});
+		delete ring;
+		for (auto &t : producers) t.join();
+		CHECK(popped == pushed);
+	}
+	CHECK(Counted::alive == 0);
+}
+
+static void TestExecutor()
+{
+	const char *SECTION = "life_lock_executor";
+
+	std::atomic<long> ran(0), nested(0);
+	{
+		edb::life_lock_executor executor(4, 64);
+		Locked live, retired;
+		auto *dead = new Locked;
+		auto deadWeak = dead->lock.gated_weak(dead);
+		dead->lock.destroy();
+		delete dead;
+		auto retiredWeak = retired.lock.gated_weak(&retired);
+		auto held = retired.lock.lock(&retired);
+		retired.lock.retire();
+
+		for (int i = 0; i < 500; ++i)
+		{
+			executor.post(live.lock.gated_weak(&live), [](Locked &l) {++l.hits;});
+			executor.post(live.lock.weak(&live),       [](Locked &l) {++l.hits;});
+			executor.post(deadWeak,    [&](Locked&) {CHECK(false);});
+			executor.post(retiredWeak, [&](Locked&) {CHECK(false);});
+			executor.post([&]() {++ran;});
+		}
+		// Tasks posting tasks go to worker-local deques, and may be stolen.
+		for (int i = 0; i < 20; ++i) executor.post([&]() {for (int j = 0; j < 100; ++j) executor.post([&]() {++nested;});});
+		while (ran < 500 || nested < 2000 || live.hits < 1000) std::this_thread::sleep_for(milliseconds(1));
+		std::this_thread::sleep_for(milliseconds(20));
+		CHECK(executor.discarded() == 500); // tasks for the destroyed target
+		held.reset();
+	}
+	{
+		// The destructor runs remaining tasks.
+		edb::life_lock_executor executor(2);
+		for (int i = 0; i < 2000; ++i) executor.post([&]() {++ran;});
+	}
+	CHECK(ran == 2500);
+	{
+		// Named callables are copied.
+		Locked target;
+		struct Hit {void operator()(Locked &l) const {++l.hits;}};
+		const Hit hit = {};
+		auto count = [&]() {++ran;};
+		{
+			edb::life_lock_executor executor(2);
+			executor.post(count);
+			executor.post(target.lock.weak(&target), hit);
+			executor.post(target.lock.gated_weak(&target), hit);
+		}
+		CHECK(ran == 2501 && target.hits == 2);
+	}
+}
+
+#ifdef __linux__
+static void TestEventfd()
+{
+	const char *SECTION = "life_lock_eventfd";
+	{
+		edb::life_lock_eventfd events;
+		pollfd readable = {events.fd(), POLLIN, 0};
+
+		auto *object = new edb::life_locked<Counted>();
+		auto held = object->lock();
+		events.retire(object);
+		CHECK(events.pending() == 1 && events.collect() == 0 && poll(&readable, 1, 0) == 0);
+		std::thread releaser([&]() {held.reset();});
+		releaser.join();
+		CHECK(poll(&readable, 1, 1000) == 1);
+		CHECK(events.collect() == 1 && events.pending() == 0 && Counted::alive == 0);
+
+		// Already expired: ready at once.
+		Part part;
+		bool done = false;
+		events.retire(part.lock, [](void *c) {*static_cast<bool*>(c) = true;}, &done);
+		CHECK(poll(&readable, 1, 0) == 1 && events.collect() == 1 && done);
+
+		// Retired elsewhere first: throws.
+		Part other;
+		auto keep = other.lock.lock(&other);
+		other.lock.retire();
+		bool threw = false;
+		try {events.retire(other.lock, [](void*) {}, nullptr);} catch (std::runtime_error&) {threw = true;}
+		CHECK(threw);
+		keep.reset();
+
+		// Many releases on another thread.
+		for (int round = 0; round < 100; ++round)
+		{
+			std::vector<std::shared_ptr<Counted>> refs;
+			for (int j = 0; j < 8; ++j)
+			{
+				auto *o = new edb::life_locked<Counted>();
+				refs.push_back(o->lock());
+				events.retire(o);
+			}
+			std::thread clearer([&]() {refs.clear();});
+			size_t collected = 0;
+			while (collected < 8) {poll(&readable, 1, 1000); collected += events.collect();}
+			clearer.join();
+		}
+	}
+	CHECK(Counted::alive == 0);
+}
+#endif
+
+
+int main(int argc, char **argv)
+{
+	TestArray();
+	TestPool();
+	TestBiased();
+	TestAsymmetric();
+	TestSeq();
+	TestRW();
+	TestGraveyard();
+	TestTree();
+	TestRCU();
+	TestSignal();
+	TestRing();
+	TestExecutor();
+#ifdef __linux__
+	TestEventfd();
+#endif
+
+	std::cout << (failures ? "FAILED" : "PASSED") << std::endl;
+	return failures ? 1 : 0;
+}
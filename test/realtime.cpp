@@ -0,0 +1,249 @@
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cerrno>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <chrono>
+
+
+// May be defined to 0 to check that the test catches the default profile.
+#ifndef LIFE_LOCK_REALTIME
+	#define LIFE_LOCK_REALTIME 1
+#endif
+
+#include <life_lock.hpp>
+
+
+/*
+	Certifies the real-time profile: locking weak pointers, releasing strong
+		references (including the last one, which runs the deleter) and retiring
+		a life_lock must not allocate or enter the kernel.
+
+	The holder path runs in a forked child, on a dedicated thread under a seccomp
+		filter which traps every system call except exit and rt_sigreturn.
+		A SIGSYS handler counts the trapped calls, and malloc is interposed to
+		count allocations.  Results are reported through shared memory.
+
+	Meanwhile a second, unfiltered thread is blocked in wait_expired(), so that
+		a deleter which notifies waiters would have to enter the kernel.
+		The test is built as C++20, where that notification would otherwise occur.
+
+	Exits with 77 (skipped) where seccomp or the interposition is unavailable.
+*/
+
+#if defined(__linux__) && defined(__GLIBC__) && (defined(__x86_64__) || defined(__aarch64__))
+
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <ucontext.h>
+
+
+struct Report
+{
+	// Lock-free atomics, which are safe to share between processes.
+	std::atomic<size_t> syscalls, allocs, lastSyscall, locks;
+	std::atomic<bool>   skipped, selfCheckPassed, expired, finished, waiterWoke;
+};
+
+static Report           *report = nullptr;
+static std::atomic<bool> measuring(false);
+
+
+// Interpose the allocator, counting allocations made while measuring.
+extern "C"
+{
+	void *__libc_malloc(size_t);
+	void *__libc_calloc(size_t, size_t);
+	void *__libc_realloc(void*, size_t);
+	void  __libc_free(void*);
+
+	void *malloc(size_t n)               {if (measuring) ++report->allocs; return __libc_malloc(n);}
+	void *calloc(size_t n, size_t s)     {if (measuring) ++report->allocs; return __libc_calloc(n, s);}
+	void *realloc(void *p, size_t n)     {if (measuring) ++report->allocs; return __libc_realloc(p, n);}
+	void  free(void *p)                  {__libc_free(p);}
+}
+
+static void OnSigSys(int, siginfo_t *info, void *context)
+{
+	// Thread exit makes system calls after measurement ends.
+	if (!measuring) return;
+	++report->syscalls;
+	report->lastSyscall = size_t(info->si_syscall);
+	// The trapped call was not executed; make it fail.
+#if defined(__x86_64__)
+	static_cast<ucontext_t*>(context)->uc_mcontext.gregs[REG_RAX] = -ENOSYS;
+#else
+	static_cast<ucontext_t*>(context)->uc_mcontext.regs[0] = uint64_t(-ENOSYS);
+#endif
+}
+
+static bool TrapSyscalls()
+{
+	struct sigaction action = {};
+	action.sa_sigaction = OnSigSys;
+	action.sa_flags = SA_SIGINFO;
+	if (sigaction(SIGSYS, &action, nullptr) != 0) return false;
+
+	struct sock_filter filter[] =
+	{
+		BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_rt_sigreturn, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_exit_group, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_exit, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+		BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+	};
+	struct sock_fprog program = {(unsigned short) (sizeof(filter) / sizeof(filter[0])), filter};
+
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) return false;
+	return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+}
+
+
+struct Receiver
+{
+	size_t         itemCount = 0;
+	edb::life_lock lock;
+
+	Receiver() : lock(this) {}
+	~Receiver() {lock.destroy();}
+};
+
+// Whether a thread is asleep in the kernel, as reported by /proc.
+static bool IsSleeping(long tid)
+{
+	char path[64], stat[256] = {};
+	snprintf(path, sizeof(path), "/proc/self/task/%ld/stat", tid);
+	FILE *file = fopen(path, "r");
+	if (!file) return false;
+	size_t n = fread(stat, 1, sizeof(stat) - 1, file);
+	fclose(file);
+	const char *state = strrchr(stat, ')');
+	return n && state && state[1] == ' ' && state[2] == 'S';
+}
+
+static void RunHolder(Receiver &receiver, std::weak_ptr<Receiver> &weak, edb::gated_weak_ptr<Receiver> &gated)
+{
+	std::shared_ptr<Receiver> held;
+	const size_t LOCK_COUNT = 100000;
+
+	// Let the allocator set up this thread's arena, then install the filter for this thread only.
+	free(malloc(16));
+	if (!TrapSyscalls()) {report->skipped = true; return;}
+
+	// Check that the harness notices violations.
+	measuring = true;
+	{
+		void *volatile p = malloc(16);
+		free(p);
+		syscall(SYS_getppid);
+		report->selfCheckPassed = (report->allocs == 1 && report->syscalls == 1);
+		report->allocs = 0;
+		report->syscalls = 0;
+	}
+
+	// The holder path.
+	for (size_t i = 0; i < LOCK_COUNT; ++i)
+	{
+		if (auto p = weak.lock())  {++p->itemCount; ++report->locks;}
+		if (auto p = gated.lock()) {std::shared_ptr<Receiver> copy = p; ++copy->itemCount;}
+	}
+
+	// Retire with a reference outstanding, then release it, running the deleter.
+	held = weak.lock();
+	receiver.lock.retire();
+	held.reset();
+	report->expired = (receiver.lock.status() == edb::life_lock::expired);
+	receiver.lock.destroy(); // no waiting required
+
+	measuring = false;
+	report->finished = true;
+}
+
+static void RunChild()
+{
+	// Everything that may allocate or enter the kernel happens before the filter is installed.
+	Receiver receiver;
+	std::weak_ptr<Receiver>       weak  = receiver.lock.weak(&receiver);
+	edb::gated_weak_ptr<Receiver> gated = receiver.lock.gated_weak(&receiver);
+
+	// Block a thread until the lock expires.
+	std::atomic<long> waiterId(0);
+	std::thread waiter([&]()
+	{
+		waiterId = syscall(SYS_gettid);
+		receiver.lock.wait_expired();
+		report->waiterWoke = true;
+	});
+	while (!waiterId || !IsSleeping(waiterId)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	std::thread holder([&]() {RunHolder(receiver, weak, gated);});
+	holder.join();
+	if (report->skipped) _exit(0);
+
+	// A waiter whose wake-up was trapped stays blocked.
+	for (int i = 0; i < 2000 && !report->waiterWoke; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	if (report->waiterWoke) waiter.join();
+	else                    waiter.detach();
+	_exit(0);
+}
+
+
+int main(int argc, char **argv)
+{
+	void *shared = mmap(nullptr, sizeof(Report), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {std::cout << "mmap failed" << std::endl; return 1;}
+	report = new (shared) Report();
+
+	pid_t child = fork();
+	if (child == 0) RunChild();
+
+	int status = 0;
+	waitpid(child, &status, 0);
+
+	if (report->skipped)
+	{
+		std::cout << "Skipped: seccomp is unavailable." << std::endl;
+		return 77;
+	}
+	std::cout << "Locks:       " << report->locks << std::endl;
+	std::cout << "Allocations: " << report->allocs << std::endl;
+	std::cout << "Syscalls:    " << report->syscalls;
+	if (report->syscalls) std::cout << " (last: " << report->lastSyscall << ")";
+	std::cout << std::endl;
+
+	bool passed = report->finished && report->selfCheckPassed && report->expired && report->waiterWoke
+		&& report->allocs == 0 && report->syscalls == 0;
+	if (!report->finished)        std::cout << "Child did not finish (status " << status << ")" << std::endl;
+	if (!report->selfCheckPassed) std::cout << "Self-check failed: violations would go unnoticed" << std::endl;
+	if (!report->expired)         std::cout << "Lock did not expire" << std::endl;
+	if (!report->waiterWoke)      std::cout << "Waiting thread was not woken" << std::endl;
+	std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+	return passed ? 0 : 1;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+	std::cout << "Skipped: this test requires Linux, glibc and x86_64 or aarch64." << std::endl;
+	return 77;
+}
+
+#endif